@@ -15,26 +15,71 @@
 #include <assert.h>
 #include <string.h>
 #include <mpi.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 // Variáveis para a comunicação MPI (trocar informações entre processos)
 const int WORK = 1;
 const int STOP = 2;
 const int FOUND = 3;
 const int FAIL = 4;
+const int COUNT = 5; // Fim de unidade no modo -c, com o número de soluções achadas nela
+const int DONE = 6;  // Fim de um pedido no modo servidor; os STOP que sobraram vêm antes dele
+const int REQUEST = 7; // Modo servidor: texto de um pedido, do P0 para o líder de um grupo
+const int REPLY = 8;   // Modo servidor: resposta do pedido, do líder de volta ao P0
+const int CANCEL = 9;  // Modo servidor: o cliente do pedido em execução no grupo desistiu
+
+// Heurísticas de ordenação dos candidatos dentro de cada bucket de cor (opção -o)
+#define ORDER_ID 0         // ordem original, pelo id da peça
+#define ORDER_RARE 1       // peças com cores mais raras primeiro
+#define ORDER_CONSTRAINT 2 // peças que casam com menos outras peças primeiro
+#define ORDER_FAILS 3      // adaptativa: peças que menos falharam primeiro
+
+// Algoritmos de busca disponíveis (opção -s)
+#define SOLVER_SPIRAL 0 // backtracking em espiral, uma tarefa por peça de vértice e sentido
+#define SOLVER_MITM 1   // meet-in-the-middle, uma fatia das duas metades por trabalhador
+#define SOLVER_DLX 2    // cobertura exata com Dancing Links, um ramo do nível de divisão por unidade
+#define SOLVER_AUTO 3   // sondas paralelas escolhem ordenação e tarefa inicial, depois a espiral
+#define SOLVER_MACRO 4  // blocos 2x2 pré-computados, uma fatia da tabela e da busca por trabalhador
 
 typedef struct {
   unsigned int colors[4];
   unsigned char rotation;
   unsigned int id;
   int used;
+  unsigned int score; // chave de ordenação dos buckets (menor é tentada antes)
+  unsigned int fails; // quantas vezes a subárvore dessa peça falhou (só contado com -o fails)
 } tile;
 
 typedef struct {
     tile **tiles;
     unsigned int count;
     unsigned int capacity;
+    unsigned char *edges[4]; // Cor N/E/S/W de cada (peça, rotação), na posição i * 4 + rotação
 } tile_list;
 
+// Situação de cada lado de uma célula quando ela é visitada
+#define SIDE_BORDER 0 // borda do tabuleiro, exige cor 0
+#define SIDE_FREE 1   // vizinho ainda vazio
+#define SIDE_PLACED 2 // vizinho já colocado antes na ordem de visita
+
+// Célula da ordem de visita. from é o lado (0 N, 1 E, 2 S, 3 W) do vizinho já colocado que
+// define o bucket de candidatos (-1 na primeira célula).
+typedef struct {
+  unsigned int x, y;
+  int from;
+  unsigned char side[4]; // SIDE_* de cada lado
+  tile **slot;           // posição da célula no tabuleiro
+  tile **neighbor[4];    // posição de cada vizinho no tabuleiro (NULL na borda)
+} visit;
+
 typedef struct {
   unsigned int size;
   unsigned int tile_count;
@@ -43,6 +88,16 @@ typedef struct {
   tile *tiles;
   tile_list **color_buckets;
   tile_list *tiles_vertice;
+  int ordering; // Heurística de ordenação dos candidatos (ORDER_*)
+  unsigned long long hash;          // Hash Zobrist do estado atual (peças usadas + cores da fronteira)
+  unsigned long long *zobrist_tile;
+  unsigned long long *zobrist_edge;
+  unsigned long long *nogoods;      // Tabela de nogoods compartilhada pelos processos do nó (NULL se desativada)
+  unsigned long long nogood_mask;
+  visit *spiral[2]; // Ordem de visita da espiral normal (0) e da inversa (1)
+  unsigned int clues; // Peças fixas pela entrada, que ocupam o início das ordens de visita
+  unsigned int endgame; // Células restantes em que a busca passa para solve_endgame (0 desativa)
+  MPI_Comm comm; // Processos que resolvem este tabuleiro; o rank 0 dele distribui as tarefas
 } game;
 
 typedef struct {
@@ -50,12 +105,34 @@ typedef struct {
     unsigned char rotation;
 } solution_tile;
 
+#define MAX_PREFIX 6   // Profundidade máxima da divisão de tarefas pelo P0
+#define SPLIT_FACTOR 4 // Unidades de trabalho desejadas por trabalhador
+
+// Subárvore da busca: a tarefa vertex_choice de play_first com as depth primeiras células da
+// ordem de visita fixadas (depth = 0 é a tarefa inteira), contadas depois das dicas.
+// Vai para o trabalhador como inteiros.
+typedef struct {
+    int vertex_choice;
+    unsigned int depth;
+    unsigned int prefix[MAX_PREFIX]; // id * 4 + rotação de cada célula fixada
+    double estimate;
+} subtask;
+
 #define X_COLOR(t, s) (t->colors[(s + 4 - t->rotation) % 4])
 #define N_COLOR(t) (X_COLOR(t, 0))
 #define E_COLOR(t) (X_COLOR(t, 1))
 #define S_COLOR(t) (X_COLOR(t, 2))
 #define W_COLOR(t) (X_COLOR(t, 3))
 
+#define H_EDGE(g, x, y) ((y) * ((g)->size - 1) + (x))
+#define V_EDGE(g, x, y) ((g)->size * ((g)->size - 1) + (y) * (g)->size + (x))
+
+#define NOGOOD_WAYS 4
+
+#define MAX_BOARD_SIZE 128 // maior lado aceito: o MITM guarda id * 4 + rotação em 16 bits
+
+#define ANY_COLOR 0xFFFFu // Lado da célula sem restrição (vizinho ainda vazio)
+
 void add_tile(tile_list *list, tile *t) {
   for (unsigned int i = 0; i < list->count; i++) {
     if (list->tiles[i]->id == t->id) return;
@@ -69,8 +146,9 @@ void add_tile(tile_list *list, tile *t) {
 }
 
 void find_vertex(game *g) {
-  g->tiles_vertice = calloc(1, sizeof(tile_list));
+  if (g->tiles_vertice == NULL) g->tiles_vertice = calloc(1, sizeof(tile_list));
   assert(g->tiles_vertice != NULL);
+  g->tiles_vertice->count = 0;
   for (unsigned int i = 0; i < g->tile_count; i++) {
     tile *current_tile = &g->tiles[i];
     int zero_count = 0;
@@ -83,13 +161,17 @@ void find_vertex(game *g) {
   }
 }
 
+// Os buckets de um jogo reaproveitado (game_shell) são só esvaziados, mantendo a capacidade
 void create_color_list(game *g) {
-  g->color_buckets = calloc(g->ncolors, sizeof(tile_list*));
-  assert(g->color_buckets != NULL);
-  for (unsigned int i = 0; i < g->ncolors; i++) {
-    g->color_buckets[i] = calloc(1, sizeof(tile_list));
-    assert(g->color_buckets[i] != NULL);
+  if (g->color_buckets == NULL) {
+    g->color_buckets = calloc(g->ncolors, sizeof(tile_list*));
+    assert(g->color_buckets != NULL);
+    for (unsigned int i = 0; i < g->ncolors; i++) {
+      g->color_buckets[i] = calloc(1, sizeof(tile_list));
+      assert(g->color_buckets[i] != NULL);
+    }
   }
+  for (unsigned int i = 0; i < g->ncolors; i++) g->color_buckets[i]->count = 0;
   for (unsigned int i = 0; i < g->tile_count; i++) {
     tile *current_tile = &g->tiles[i];
     for (int c = 0; c < 4; c++) {
@@ -101,44 +183,485 @@ void create_color_list(game *g) {
   }
 }
 
-// Função Usada para que cada processador do MPI possa ter uma cópia do jogo para fazer sua busca
-game *create_game_worker(unsigned int bsize, unsigned int ncolors, tile* tiles_data, int tile_count) {
-    game *g = malloc(sizeof(game));
+// Preenche, para cada célula da ordem, a situação de cada lado no momento da visita e os
+// ponteiros para a célula e os vizinhos no tabuleiro, usados por play_table
+void link_visit_order(game *g, visit *order) {
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  unsigned int n = g->size;
+  unsigned int *position = malloc(g->tile_count * sizeof(unsigned int));
+  assert(position != NULL);
+  for (unsigned int d = 0; d < g->tile_count; d++) position[order[d].y * n + order[d].x] = d;
+  for (unsigned int d = 0; d < g->tile_count; d++) {
+    visit *v = &order[d];
+    v->slot = &g->board[v->y][v->x];
+    for (int s = 0; s < 4; s++) {
+      int nx = (int)v->x + dx[s], ny = (int)v->y + dy[s];
+      if (nx < 0 || ny < 0 || nx >= (int)n || ny >= (int)n) {
+        v->side[s] = SIDE_BORDER;
+        v->neighbor[s] = NULL;
+      } else {
+        v->side[s] = position[ny * n + nx] < d ? SIDE_PLACED : SIDE_FREE;
+        v->neighbor[s] = &g->board[ny][nx];
+      }
+    }
+  }
+  free(position);
+}
+
+// Calcula a ordem em que a espiral normal (inversa = 0) ou a anti-horária (inversa = 1) visita
+// as células a partir do canto (0,0)
+void build_visit_order(game *g, int inversa, visit *order) {
+  unsigned int n = g->size, x = 0, y = 0;
+  char *filled = calloc(g->tile_count, 1);
+  assert(filled != NULL);
+  order[0].x = 0; order[0].y = 0; order[0].from = -1;
+  filled[0] = 1;
+  for (unsigned int d = 1; d < g->tile_count; d++) {
+    int from;
+    if (!inversa) {
+      if (x < n - 1 && !filled[y * n + x + 1] && (y == 0 || filled[(y - 1) * n + x])) { x++; from = 3; }
+      else if (y < n - 1 && !filled[(y + 1) * n + x]) { y++; from = 0; }
+      else if (x > 0 && !filled[y * n + x - 1]) { x--; from = 1; }
+      else { y--; from = 2; }
+    } else {
+      if (y < n - 1 && !filled[(y + 1) * n + x] && (x == 0 || filled[y * n + x - 1])) { y++; from = 0; }
+      else if (x < n - 1 && !filled[y * n + x + 1]) { x++; from = 3; }
+      else if (y > 0 && !filled[(y - 1) * n + x]) { y--; from = 2; }
+      else { x--; from = 1; }
+    }
+    assert(!filled[y * n + x]);
+    filled[y * n + x] = 1;
+    order[d].x = x; order[d].y = y; order[d].from = from;
+  }
+  free(filled);
+  link_visit_order(g, order);
+}
+
+// Cor exigida pelo vizinho do lado from da célula, que indica o bucket de candidatos
+unsigned int visit_color(game *g, const visit *v) {
+  if (v->from < 0) return 0;
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  tile *neighbor = g->board[v->y + dy[v->from]][v->x + dx[v->from]];
+  return X_COLOR(neighbor, (v->from + 2) % 4);
+}
+
+// Ordem de visita com dicas: primeiro as células fixas, depois o canto (0,0) se estiver livre e
+// então sempre a célula livre mais restrita (vizinhos já colocados + lados de borda) entre as que
+// têm algum vizinho colocado, com empate decidido pela posição na espiral. Assim os vizinhos das
+// dicas entram assim que a busca encosta nelas e já são podados contra as cores fixas.
+void build_clue_order(game *g, int inversa, visit *order) {
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  unsigned int n = g->size, d = 0;
+  unsigned int *rank = malloc(g->tile_count * sizeof(unsigned int));
+  char *filled = calloc(g->tile_count, 1);
+  assert(rank != NULL && filled != NULL);
+  build_visit_order(g, inversa, order);
+  for (unsigned int i = 0; i < g->tile_count; i++) rank[order[i].y * n + order[i].x] = i;
+
+  for (unsigned int y = 0; y < n; y++)
+    for (unsigned int x = 0; x < n; x++)
+      if (g->board[y][x] != NULL) {
+        order[d].x = x; order[d].y = y; order[d].from = -1;
+        filled[y * n + x] = 1;
+        d++;
+      }
+  if (!filled[0]) {
+    order[d].x = 0; order[d].y = 0; order[d].from = -1;
+    filled[0] = 1;
+    d++;
+  }
+  for (; d < g->tile_count; d++) {
+    unsigned int best = g->tile_count;
+    int best_score = -1, best_from = -1;
+    for (unsigned int c = 0; c < g->tile_count; c++) {
+      if (filled[c]) continue;
+      int x = c % n, y = c / n, score = 0, from = -1;
+      for (int s = 0; s < 4; s++) {
+        int nx = x + dx[s], ny = y + dy[s];
+        if (nx < 0 || ny < 0 || nx >= (int)n || ny >= (int)n) score++;
+        else if (filled[ny * n + nx]) { score++; if (from < 0) from = s; }
+      }
+      if (from < 0) continue;
+      if (score > best_score || (score == best_score && rank[c] < rank[best])) {
+        best = c; best_score = score; best_from = from;
+      }
+    }
+    assert(best < g->tile_count);
+    order[d].x = best % n; order[d].y = best / n; order[d].from = best_from;
+    filled[best] = 1;
+  }
+
+  free(rank);
+  free(filled);
+  link_visit_order(g, order);
+}
+
+// Empacota as cores de todas as rotações de cada bucket em vetores de bytes, um por lado,
+// para o filtro de candidatos comparar um bucket inteiro de uma vez. Precisa ser refeito
+// sempre que a ordem dos buckets mudar. O tamanho é arredondado para 32 (um registrador AVX2).
+void pack_buckets(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    unsigned int padded = (list->count * 4 + 31) & ~31u;
+    for (int s = 0; s < 4; s++) {
+      free(list->edges[s]);
+      list->edges[s] = calloc(padded + 32, 1);
+      assert(list->edges[s] != NULL);
+    }
+    for (unsigned int i = 0; i < list->count; i++) {
+      tile *t = list->tiles[i];
+      for (unsigned int rot = 0; rot < 4; rot++)
+        for (int s = 0; s < 4; s++)
+          list->edges[s][i * 4 + rot] = (unsigned char)t->colors[(s + 4 - rot) % 4];
+    }
+  }
+}
+
+// Filtros de candidatos: marcam em valid o bit i * 4 + rotação de cada (peça, rotação) do
+// bucket cujas cores batem com req (ANY_COLOR = lado livre). valid já vem zerado.
+void filter_scalar(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  for (unsigned int k = 0; k < list->count * 4; k++) {
+    int ok = 1;
+    for (int s = 0; s < 4 && ok; s++)
+      if (req[s] != ANY_COLOR && list->edges[s][k] != req[s]) ok = 0;
+    if (ok) valid[k / 64] |= 1ULL << (k % 64);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 16 rotações por iteração, disponível em todo x86-64
+__attribute__((target("sse2")))
+void filter_sse2(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  __m128i want[4];
+  int active[4], nactive = 0;
+  for (int s = 0; s < 4; s++)
+    if (req[s] != ANY_COLOR) {
+      active[nactive] = s;
+      want[nactive++] = _mm_set1_epi8((char)req[s]);
+    }
+  for (unsigned int k = 0; k < list->count * 4; k += 16) {
+    __m128i ok = _mm_set1_epi8(-1);
+    for (int a = 0; a < nactive; a++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(list->edges[active[a]] + k));
+      ok = _mm_and_si128(ok, _mm_cmpeq_epi8(v, want[a]));
+    }
+    valid[k / 64] |= (unsigned long long)(unsigned int)_mm_movemask_epi8(ok) << (k % 64);
+  }
+}
+
+// 32 rotações por iteração
+__attribute__((target("avx2")))
+void filter_avx2(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  __m256i want[4];
+  int active[4], nactive = 0;
+  for (int s = 0; s < 4; s++)
+    if (req[s] != ANY_COLOR) {
+      active[nactive] = s;
+      want[nactive++] = _mm256_set1_epi8((char)req[s]);
+    }
+  for (unsigned int k = 0; k < list->count * 4; k += 32) {
+    __m256i ok = _mm256_set1_epi8(-1);
+    for (int a = 0; a < nactive; a++) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(list->edges[active[a]] + k));
+      ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(v, want[a]));
+    }
+    valid[k / 64] |= (unsigned long long)(unsigned int)_mm256_movemask_epi8(ok) << (k % 64);
+  }
+}
+#endif
+
+// Filtro escolhido em tempo de execução por select_filter, conforme a CPU de cada processo
+void (*filter_bucket)(tile_list *, const unsigned int[4], unsigned long long *) = filter_scalar;
+
+void select_filter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) filter_bucket = filter_avx2;
+  else if (__builtin_cpu_supports("sse2")) filter_bucket = filter_sse2;
+#endif
+}
+
+// Filtra o bucket com as restrições req. valid precisa ter count / 16 + 1 palavras.
+static inline void filter_masked(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  memset(valid, 0, (list->count / 16 + 1) * sizeof(unsigned long long));
+  filter_bucket(list, req, valid);
+  // Os bytes de preenchimento depois da última peça podem ter batido com a cor 0
+  if ((list->count * 4) % 64) valid[list->count / 16] &= (1ULL << ((list->count * 4) % 64)) - 1;
+}
+
+// Monta as restrições da célula (x,y) (borda exige cor 0, vizinho colocado exige a cor dele)
+// e filtra o bucket. valid precisa ter count / 16 + 1 palavras.
+void filter_candidates(game *game, tile_list *list, unsigned int x, unsigned int y, unsigned long long *valid) {
+  unsigned int req[4];
+  req[0] = (y == 0) ? 0 : (game->board[y - 1][x] ? S_COLOR(game->board[y - 1][x]) : ANY_COLOR);
+  req[1] = (x == game->size - 1) ? 0 : (game->board[y][x + 1] ? W_COLOR(game->board[y][x + 1]) : ANY_COLOR);
+  req[2] = (y == game->size - 1) ? 0 : (game->board[y + 1][x] ? N_COLOR(game->board[y + 1][x]) : ANY_COLOR);
+  req[3] = (x == 0) ? 0 : (game->board[y][x - 1] ? E_COLOR(game->board[y][x - 1]) : ANY_COLOR);
+  filter_masked(list, req, valid);
+}
+
+// Mesmas restrições, lidas da tabela da ordem de visita. Retorna o bucket de candidatos.
+static inline tile_list *visit_requirements(game *g, const visit *v, unsigned int req[4]) {
+  for (int s = 0; s < 4; s++) {
+    if (v->side[s] == SIDE_BORDER) req[s] = 0;
+    else if (v->side[s] == SIDE_PLACED) req[s] = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+    else req[s] = ANY_COLOR;
+  }
+  return g->color_buckets[v->from < 0 ? 0 : req[v->from]];
+}
+
+// Critério do qsort: menor score primeiro, empate decidido pelo id para manter a ordem estável
+int compare_tiles(const void *a, const void *b) {
+  const tile *ta = *(tile * const *)a;
+  const tile *tb = *(tile * const *)b;
+  if (ta->score != tb->score) return (ta->score < tb->score) ? -1 : 1;
+  return (ta->id < tb->id) ? -1 : (ta->id > tb->id);
+}
+
+void sort_buckets(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    qsort(list->tiles, list->count, sizeof(tile*), compare_tiles);
+  }
+}
+
+// Confere se cada bucket está em ordem de (score, id)
+int buckets_sorted(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    for (unsigned int k = 1; k < list->count; k++)
+      if (compare_tiles(&list->tiles[k - 1], &list->tiles[k]) > 0) return 0;
+  }
+  return 1;
+}
+
+// Mesmas heurísticas da versão sequencial: RARE soma a frequência das cores da peça,
+// CONSTRAINT conta quantas outras peças compartilham alguma cor não cinza com ela
+void order_candidates(game *g) {
+  unsigned int *freq = calloc(g->ncolors, sizeof(unsigned int));
+  unsigned int *mark = malloc(g->tile_count * sizeof(unsigned int));
+  assert(freq != NULL && mark != NULL);
+  for (unsigned int i = 0; i < g->tile_count; i++) {
+    mark[i] = g->tile_count;
+    for (int c = 0; c < 4; c++)
+      if (g->tiles[i].colors[c] < g->ncolors) freq[g->tiles[i].colors[c]]++;
+  }
+
+  for (unsigned int i = 0; i < g->tile_count; i++) {
+    tile *t = &g->tiles[i];
+    t->score = 0;
+    t->fails = 0;
+    if (g->ordering == ORDER_RARE) {
+      for (int c = 0; c < 4; c++)
+        if (t->colors[c] != 0 && t->colors[c] < g->ncolors) t->score += freq[t->colors[c]];
+    } else if (g->ordering == ORDER_CONSTRAINT) {
+      for (int c = 0; c < 4; c++) {
+        if (t->colors[c] == 0 || t->colors[c] >= g->ncolors) continue;
+        tile_list *list = g->color_buckets[t->colors[c]];
+        for (unsigned int k = 0; k < list->count; k++) {
+          if (list->tiles[k] != t && mark[list->tiles[k]->id] != i) {
+            mark[list->tiles[k]->id] = i;
+            t->score++;
+          }
+        }
+      }
+    }
+  }
+  free(freq);
+  free(mark);
+
+  // Sempre reordena: com ORDER_ID todos os scores são 0 e o desempate pelo id volta à ordem
+  // original, mesmo que uma sonda de -s auto tenha deixado os buckets em outra ordem
+  sort_buckets(g);
+  assert(buckets_sorted(g));
+  pack_buckets(g);
+}
+
+// Só pode ser chamada entre subárvores da raiz, pois play_table percorre os buckets por índice.
+// Cada trabalhador aprende com as falhas das suas próprias tarefas.
+void reorder_buckets(game *g) {
+  if (g->ordering != ORDER_FAILS) return;
+  for (unsigned int i = 0; i < g->tile_count; i++)
+    g->tiles[i].score = g->tiles[i].fails;
+  sort_buckets(g);
+  pack_buckets(g);
+}
+
+unsigned long long splitmix64(unsigned long long *state) {
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// A semente é fixa: todos os processos geram as mesmas chaves e podem dividir a tabela
+void init_zobrist(game *g) {
+  unsigned long long seed = 0x2545F4914F6CDD1DULL;
+  unsigned int edge_keys = 2 * g->size * (g->size - 1) * g->ncolors;
+  g->hash = 0;
+  g->zobrist_tile = malloc(g->tile_count * sizeof(unsigned long long));
+  g->zobrist_edge = malloc((edge_keys + 1) * sizeof(unsigned long long));
+  assert(g->zobrist_tile != NULL && g->zobrist_edge != NULL);
+  for (unsigned int i = 0; i < g->tile_count; i++) g->zobrist_tile[i] = splitmix64(&seed);
+  for (unsigned int i = 0; i < edge_keys; i++) g->zobrist_edge[i] = splitmix64(&seed);
+  g->nogoods = NULL;
+  g->nogood_mask = 0;
+}
+
+// Coloca ou retira a peça t de (x,y) no hash, igual à versão sequencial
+void zobrist_toggle(game *g, unsigned int x, unsigned int y, tile *t) {
+  unsigned long long *k = g->zobrist_edge;
+  unsigned int nc = g->ncolors;
+  unsigned long long h = g->hash ^ g->zobrist_tile[t->id];
+  if (x > 0) h ^= k[H_EDGE(g, x - 1, y) * nc + W_COLOR(t)];
+  if (x < g->size - 1) h ^= k[H_EDGE(g, x, y) * nc + E_COLOR(t)];
+  if (y > 0) h ^= k[V_EDGE(g, x, y - 1) * nc + N_COLOR(t)];
+  if (y < g->size - 1) h ^= k[V_EDGE(g, x, y) * nc + S_COLOR(t)];
+  g->hash = h;
+}
+
+// A tabela fica numa janela de memória compartilhada do MPI. Cada posição é um hash de
+// 64 bits lido e escrito atomicamente, então não precisa de trava: no pior caso uma escrita
+// concorrente perde um nogood, o que só custa refazer a busca daquela subárvore.
+int nogood_lookup(game *g) {
+  if (g->nogoods == NULL) return 0;
+  unsigned long long key = g->hash ? g->hash : 1;
+  unsigned long long *set = &g->nogoods[key & g->nogood_mask & ~(NOGOOD_WAYS - 1ULL)];
+  for (int i = 0; i < NOGOOD_WAYS; i++)
+    if (__atomic_load_n(&set[i], __ATOMIC_RELAXED) == key) return 1;
+  return 0;
+}
+
+void nogood_store(game *g) {
+  if (g->nogoods == NULL) return;
+  unsigned long long key = g->hash ? g->hash : 1;
+  unsigned long long *set = &g->nogoods[key & g->nogood_mask & ~(NOGOOD_WAYS - 1ULL)];
+  for (int i = 0; i < NOGOOD_WAYS; i++) {
+    unsigned long long empty = 0;
+    if (__atomic_compare_exchange_n(&set[i], &empty, key, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) || empty == key)
+      return;
+  }
+  __atomic_store_n(&set[(key >> 62) & (NOGOOD_WAYS - 1)], key, __ATOMIC_RELAXED);
+}
+
+// Cria a tabela de nogoods com até mb megabytes por nó para os processos de comm. A memória é
+// alocada pelo primeiro processo de cada nó e os demais recebem um ponteiro para ela via
+// MPI_Win_shared_query.
+MPI_Win create_nogood_window(MPI_Comm comm, unsigned int mb, unsigned long long **table, unsigned long long *mask) {
+  MPI_Comm node_comm;
+  MPI_Win win;
+  int node_rank, disp_unit;
+  MPI_Aint win_size;
+  unsigned long long slots = NOGOOD_WAYS;
+  while (slots * 2 * sizeof(unsigned long long) <= (unsigned long long)mb << 20) slots *= 2;
+
+  MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, 0, MPI_INFO_NULL, &node_comm);
+  MPI_Comm_rank(node_comm, &node_rank);
+  MPI_Win_allocate_shared(node_rank == 0 ? (MPI_Aint)(slots * sizeof(unsigned long long)) : 0,
+                          sizeof(unsigned long long), MPI_INFO_NULL, node_comm, table, &win);
+  MPI_Win_shared_query(win, 0, &win_size, &disp_unit, table);
+  if (node_rank == 0) memset(*table, 0, slots * sizeof(unsigned long long));
+  MPI_Barrier(node_comm);
+  MPI_Comm_free(&node_comm);
+  *mask = slots - 1;
+  return win;
+}
+
+int parse_ordering(const char *name) {
+  if (strcmp(name, "id") == 0) return ORDER_ID;
+  if (strcmp(name, "rare") == 0) return ORDER_RARE;
+  if (strcmp(name, "constraint") == 0) return ORDER_CONSTRAINT;
+  if (strcmp(name, "fails") == 0) return ORDER_FAILS;
+  return -1;
+}
+
+int valid_move (game *game, unsigned int x, unsigned int y, tile *tile);
+void free_resources(game *game);
+
+// Fixa no tabuleiro as dicas lidas da entrada, nclues grupos de (x, y, id, rotação). As peças
+// ficam marcadas como usadas e entram no hash; a busca nunca as desfaz.
+void place_clues(game *g, unsigned int nclues, const unsigned int *clues) {
+  g->clues = nclues;
+  for (unsigned int i = 0; i < nclues; i++) {
+    unsigned int x = clues[4 * i], y = clues[4 * i + 1], id = clues[4 * i + 2];
+    assert(x < g->size && y < g->size && id < g->tile_count && clues[4 * i + 3] < 4);
+    tile *t = &g->tiles[id];
+    assert(!t->used && g->board[y][x] == NULL);
+    t->rotation = clues[4 * i + 3];
+    assert(valid_move(g, x, y, t));
+    t->used = 1;
+    g->board[y][x] = t;
+    zobrist_toggle(g, x, y, t);
+  }
+}
+
+// Jogo vazio de lado bsize com ncolors cores (contando a cor 0). No modo servidor warm é o jogo
+// do pedido anterior: se o lado e as cores batem, o tabuleiro, as peças, os buckets, as chaves
+// Zobrist e as ordens de visita continuam alocados e só o conteúdo é refeito; senão ele é
+// liberado. Fora do modo servidor warm é sempre NULL.
+game *game_shell(game *warm, unsigned int bsize, unsigned int ncolors, int ordering) {
+  game *g = warm;
+  if (g == NULL || g->size != bsize || g->ncolors != ncolors) {
+    free_resources(warm);
+    g = calloc(1, sizeof(game));
     assert(g != NULL);
     g->ncolors = ncolors;
     g->size = bsize;
-    g->tile_count = tile_count;
+    g->tile_count = bsize * bsize;
     g->board = malloc(sizeof(tile**) * bsize);
-    for(unsigned int i = 0; i < bsize; i++)
-        g->board[i] = calloc(bsize, sizeof(tile*));
-    
     g->tiles = malloc(g->tile_count * sizeof(tile));
+    assert(g->board != NULL && g->tiles != NULL);
+    for (unsigned int i = 0; i < bsize; i++) {
+      g->board[i] = malloc(bsize * sizeof(tile*));
+      assert(g->board[i] != NULL);
+    }
+    for (int inversa = 0; inversa < 2; inversa++) {
+      g->spiral[inversa] = malloc(g->tile_count * sizeof(visit));
+      assert(g->spiral[inversa] != NULL);
+    }
+    init_zobrist(g);
+  }
+  for (unsigned int i = 0; i < bsize; i++) memset(g->board[i], 0, bsize * sizeof(tile*));
+  g->ordering = ordering;
+  return g;
+}
+
+// Monta os buckets, a ordenação e as ordens de visita a partir de g->tiles e fixa as dicas
+void setup_game(game *g, unsigned int nclues, const unsigned int *clues) {
+  create_color_list(g);
+  find_vertex(g);
+  order_candidates(g);
+  g->hash = 0;
+  place_clues(g, nclues, clues);
+  for (int inversa = 0; inversa < 2; inversa++) {
+    if (g->clues) build_clue_order(g, inversa, g->spiral[inversa]);
+    else build_visit_order(g, inversa, g->spiral[inversa]);
+  }
+}
+
+// Função Usada para que cada processador do MPI possa ter uma cópia do jogo para fazer sua busca
+game *create_game_worker(unsigned int bsize, unsigned int ncolors, tile* tiles_data, int tile_count, int ordering,
+                         unsigned int nclues, const unsigned int *clues, game *warm) {
+    game *g = game_shell(warm, bsize, ncolors, ordering);
+    assert(g->tile_count == (unsigned int)tile_count);
     memcpy(g->tiles, tiles_data, g->tile_count * sizeof(tile));
-    
-    create_color_list(g);
-    find_vertex(g);
+    // As peças chegam do P0 já com as dicas marcadas como usadas; place_clues marca de novo
+    for (unsigned int i = 0; i < g->tile_count; i++) g->tiles[i].used = 0;
+    setup_game(g, nclues, clues);
     return g;
 }
 
-game *initialize (FILE *input) {
+game *initialize (FILE *input, int ordering, game *warm) {
   unsigned int bsize;
   unsigned int ncolors_from_file;
   int r = fscanf (input, "%u", &bsize);
   assert (r == 1);
+  assert (bsize > 0 && bsize <= MAX_BOARD_SIZE);
   r = fscanf (input, "%u", &ncolors_from_file);
   assert (r == 1);
   assert (ncolors_from_file < 256);
 
-  game *g = malloc (sizeof(game));
-  assert(g != NULL);
-  g->ncolors = ncolors_from_file + 1;
-  g->size = bsize;
-  g->tile_count = bsize * bsize;
-  g->board = malloc (sizeof (tile**) * bsize);
-  for(unsigned int i = 0; i < bsize; i++)
-    g->board[i] = calloc(bsize, sizeof(tile*));
-
-  g->tiles = malloc(g->tile_count * sizeof(tile));
+  game *g = game_shell(warm, bsize, ncolors_from_file + 1, ordering);
   for (unsigned int i = 0; i < g->tile_count; i++) {
     g->tiles[i].rotation = 0;
     g->tiles[i].id = i;
@@ -149,8 +672,22 @@ game *initialize (FILE *input) {
     }
   }
 
-  create_color_list(g);
-  find_vertex(g); 
+  // Seção opcional de dicas depois das peças: a quantidade e então "x y id rotação" de cada
+  // peça fixa (x é a coluna e y a linha, contando de 0)
+  unsigned int nclues = 0;
+  unsigned int *clues = NULL;
+  if (fscanf(input, "%u", &nclues) == 1 && nclues > 0) {
+    assert(nclues <= g->tile_count);
+    clues = malloc(nclues * 4 * sizeof(unsigned int));
+    assert(clues != NULL);
+    for (unsigned int i = 0; i < nclues * 4; i++) {
+      r = fscanf(input, "%u", &clues[i]);
+      assert(r == 1);
+    }
+  }
+
+  setup_game(g, nclues, clues);
+  free(clues);
   return g;
 }
 
@@ -164,11 +701,16 @@ void free_resources(game *game) {
     for (unsigned int i = 0; i < game->ncolors; i++) {
       if (game->color_buckets[i]) {
         if (game->color_buckets[i]->tiles) free(game->color_buckets[i]->tiles);
+        for (int s = 0; s < 4; s++) free(game->color_buckets[i]->edges[s]);
         free(game->color_buckets[i]);
       }
     }
     free(game->color_buckets);
   }
+  free(game->zobrist_tile);
+  free(game->zobrist_edge);
+  free(game->spiral[0]);
+  free(game->spiral[1]);
   if (game->tiles) free(game->tiles);
   if (game->board) {
     for(unsigned int i = 0; i < game->size; i++)
@@ -190,123 +732,243 @@ int valid_move (game *game, unsigned int x, unsigned int y, tile *tile) {
   return 1;
 }
 
-void print_solution (solution_tile* solution, unsigned int size) {
+// Copia o tabuleiro preenchido para o formato enviado ao P0
+void pack_solution(game *g, solution_tile *solution) {
+    int k = 0;
+    for (unsigned int j = 0; j < g->size; j++) {
+        for (unsigned int i = 0; i < g->size; i++) {
+            tile* t = g->board[j][i];
+            solution[k].id = t->id;
+            solution[k].rotation = t->rotation;
+            k++;
+        }
+    }
+}
+
+void print_solution (FILE *out, solution_tile* solution, unsigned int size) {
     int k = 0;
     for(unsigned int j = 0; j < size; j++) {
         for(unsigned int i = 0; i < size; i++) {
-            printf("%u %u\n", solution[k].id, solution[k].rotation);
+            fprintf(out, "%u %u\n", solution[k].id, solution[k].rotation);
             k++;
         }
     }
 }
 
-int play (game *game, unsigned int x, unsigned int y, unsigned int required_color, int *stop_flag) {
-  if (*stop_flag) return 0;
+// ---------------------------------------------------------------------------------------------
+// Fim de jogo: quando faltam no máximo g->endgame células, o resto vira um emparelhamento entre
+// as células abertas e as peças livres. Na entrada, cada par (célula, peça) guarda as rotações
+// que casam com a borda e com os vizinhos já colocados; dentro do fim de jogo só falta conferir
+// os vizinhos que também são do fim de jogo. A cada nível um emparelhamento bipartido (Kuhn,
+// sobre máscaras de bits) confirma que ainda existe uma peça distinta para cada célula antes de
+// descer, e a célula tentada é a que tem menos peças candidatas.
+// ---------------------------------------------------------------------------------------------
 
-  // Apesar do professor contra-indicar o uso de variável estática foi a forma encontrada para fazer
-  // uma checagem regular do status da aplicação (sugestão do GPT)
-  static int check_counter = 0;
-  if (++check_counter % 2000 == 0) {
-      int message_present = 0;
-      // A utilização dessa função veio do GPT para como fazer a comunicação de modo não bloqueante
-      MPI_Iprobe(0, STOP, MPI_COMM_WORLD, &message_present, MPI_STATUS_IGNORE);
-      if (message_present) {
-          *stop_flag = 1;
-          return 0;
-      }
+#define ENDGAME_DEFAULT 0  // desligado por padrão: nas medições nenhum -f ganhou de forma consistente
+#define ENDGAME_MAX 24     // limite de -f (as máscaras são de 32 bits)
+
+typedef struct {
+  const visit *cells[ENDGAME_MAX];
+  tile *tiles[ENDGAME_MAX];
+  unsigned int n;
+  unsigned char rotations[ENDGAME_MAX][ENDGAME_MAX]; // bit r: a peça cabe na célula com a rotação r
+  unsigned char inner[ENDGAME_MAX];                   // bit s: o vizinho do lado s é do fim de jogo
+  int next[ENDGAME_MAX][4];                           // índice desse vizinho no fim de jogo (-1 se não for)
+  unsigned int open, free_tiles;                      // máscaras das células abertas e das peças livres
+  int count_fails;                                    // ordem fails: conta as falhas das peças
+} endgame_state;
+
+// Rotações da peça t na célula c que casam com os vizinhos do fim de jogo já colocados
+unsigned int endgame_fit(const endgame_state *e, unsigned int c, unsigned int t) {
+  unsigned int fit = e->rotations[c][t];
+  const visit *v = e->cells[c];
+  for (int s = 0; s < 4 && fit; s++) {
+    if (!(e->inner[c] >> s & 1) || *v->neighbor[s] == NULL) continue;
+    unsigned int color = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+    for (unsigned int r = 0; r < 4; r++)
+      if (e->tiles[t]->colors[(s + 4 - r) % 4] != color) fit &= ~(1u << r);
+  }
+  return fit;
+}
+
+// Caminho aumentante de Kuhn a partir da célula c
+int endgame_augment(const unsigned int *cand, unsigned int c, unsigned int *seen, int *owner) {
+  for (unsigned int m = cand[c]; m; m &= m - 1) {
+    unsigned int t = __builtin_ctz(m);
+    if (*seen >> t & 1) continue;
+    *seen |= 1u << t;
+    if (owner[t] < 0 || endgame_augment(cand, owner[t], seen, owner)) {
+      owner[t] = c;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// cand[c] são as peças livres que cabem na célula c e fit[c][t] as rotações de cada uma. Ao
+// colocar uma peça só mudam as linhas dos vizinhos dela, que são refeitas na cópia do filho.
+int endgame_search(endgame_state *e, const unsigned int *cand, unsigned char (*fit)[ENDGAME_MAX]) {
+  if (e->open == 0) return 1;
+
+  int best = -1;
+  for (unsigned int m = e->open; m; m &= m - 1) {
+    unsigned int c = __builtin_ctz(m);
+    if (cand[c] == 0) return 0;
+    if (best < 0 || __builtin_popcount(cand[c]) < __builtin_popcount(cand[best])) best = c;
+  }
+
+  // Sem emparelhamento perfeito nenhuma ordem de colocação resolve o resto
+  int owner[ENDGAME_MAX];
+  for (unsigned int t = 0; t < e->n; t++) owner[t] = -1;
+  for (unsigned int m = e->open; m; m &= m - 1) {
+    unsigned int seen = 0;
+    if (!endgame_augment(cand, __builtin_ctz(m), &seen, owner)) return 0;
   }
-  
-  tile_list *candidate_list = game->color_buckets[required_color];
-  for (unsigned int i = 0; i < candidate_list->count; i++) {
-    tile *tile = candidate_list->tiles[i];
-    if (tile->used) continue;
-    
-    tile->used = 1;
-    for (int rot = 0; rot < 4; rot++) {
-      tile->rotation = rot;
-      if (valid_move(game, x, y, tile)) {
-        game->board[y][x] = tile;
-        unsigned int nx, ny;
-        unsigned int next_required_color = 0;
-        ny = nx = game->size;
-
-        if (x < game->size - 1 && game->board[y][x + 1] == NULL && (y == 0 || game->board[y - 1][x] != NULL)) {
-          nx = x + 1; ny = y;
-          next_required_color = E_COLOR(tile);
-        } else if (y < game->size - 1 && game->board[y + 1][x] == NULL) {
-          nx = x; ny = y + 1;
-          next_required_color = S_COLOR(tile);
-        } else if (x > 0 && game->board[y][x - 1] == NULL) {
-          nx = x - 1; ny = y;
-          next_required_color = W_COLOR(tile);
-        } else if (y > 0 && game->board[y - 1][x] == NULL) {
-          nx = x; ny = y - 1;
-          next_required_color = N_COLOR(tile);
-        } else {
-          ny = game->size;
-        }
 
-        if (ny == game->size || play(game, nx, ny, next_required_color, stop_flag)) {
-          return 1;
+  const visit *v = e->cells[best];
+  unsigned int child_cand[ENDGAME_MAX];
+  unsigned char child_fit[ENDGAME_MAX][ENDGAME_MAX];
+  memcpy(child_fit, fit, e->n * sizeof(child_fit[0]));
+  e->open &= ~(1u << best);
+  for (unsigned int m = cand[best]; m; m &= m - 1) {
+    unsigned int t = __builtin_ctz(m);
+    tile *tile = e->tiles[t];
+    tile->used = 1;
+    *v->slot = tile;
+    e->free_tiles &= ~(1u << t);
+    for (unsigned int c = 0; c < e->n; c++) child_cand[c] = cand[c] & ~(1u << t);
+    for (unsigned int r = 0; r < 4; r++) {
+      if (!(fit[best][t] >> r & 1)) continue;
+      tile->rotation = r;
+      for (int s = 0; s < 4; s++) {
+        int c = e->next[best][s];
+        if (c < 0 || !(e->open >> c & 1)) continue;
+        child_cand[c] = 0;
+        for (unsigned int f = e->free_tiles; f; f &= f - 1) {
+          unsigned int u = __builtin_ctz(f);
+          child_fit[c][u] = endgame_fit(e, c, u);
+          if (child_fit[c][u]) child_cand[c] |= 1u << u;
         }
-        game->board[y][x] = NULL;
       }
+      if (endgame_search(e, child_cand, child_fit)) return 1;
     }
+    e->free_tiles |= 1u << t;
+    *v->slot = NULL;
     tile->used = 0;
+    if (e->count_fails) tile->fails++;
   }
+  e->open |= 1u << best;
   return 0;
 }
 
-int play_inversa (game *game, unsigned int x, unsigned int y, unsigned int required_color, int *stop_flag) {
+// Resolve as células order[0..n) com as peças ainda livres. Em caso de falha o tabuleiro volta
+// como estava.
+int solve_endgame(game *g, const visit *order, unsigned int n) {
+  endgame_state e;
+  e.n = n;
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < g->tile_count; i++)
+    if (!g->tiles[i].used) e.tiles[k++] = &g->tiles[i];
+  assert(k == n);
+
+  unsigned int cand[ENDGAME_MAX];
+  for (unsigned int c = 0; c < n; c++) {
+    const visit *v = &order[c];
+    e.cells[c] = v;
+    e.inner[c] = 0;
+    unsigned int req[4];
+    for (int s = 0; s < 4; s++) {
+      if (v->side[s] == SIDE_BORDER) req[s] = 0;
+      else if (*v->neighbor[s] != NULL) req[s] = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+      else {
+        req[s] = ANY_COLOR;
+        e.inner[c] |= 1 << s;
+      }
+    }
+    cand[c] = 0;
+    for (unsigned int t = 0; t < n; t++) {
+      const unsigned int *colors = e.tiles[t]->colors;
+      e.rotations[c][t] = 0;
+      for (unsigned int r = 0; r < 4; r++) {
+        int ok = 1;
+        for (int s = 0; s < 4; s++)
+          ok &= (req[s] == ANY_COLOR) | (colors[(s + 4 - r) % 4] == req[s]);
+        e.rotations[c][t] |= ok << r;
+      }
+      if (e.rotations[c][t]) cand[c] |= 1u << t;
+    }
+    if (cand[c] == 0) return 0;
+  }
+  // Quase sempre alguma célula já fica sem candidatas acima; só então vale ligar os vizinhos
+  for (unsigned int c = 0; c < n; c++)
+    for (int s = 0; s < 4; s++) {
+      e.next[c][s] = -1;
+      if (!(e.inner[c] >> s & 1)) continue;
+      for (unsigned int o = 0; o < n; o++)
+        if (order[o].slot == order[c].neighbor[s]) e.next[c][s] = o;
+    }
+  e.open = (1u << n) - 1;
+  e.free_tiles = e.open;
+  e.count_fails = g->ordering == ORDER_FAILS;
+  return endgame_search(&e, cand, e.rotations);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Busca em espiral guiada pela tabela da ordem de visita, que já diz para cada célula quais
+// lados são borda, quais vizinhos já estão colocados e onde eles ficam no tabuleiro. Assim o
+// laço interno não testa limites nem procura a próxima célula.
+// ---------------------------------------------------------------------------------------------
+
+int play_table(game *g, const visit *order, unsigned int depth, int *stop_flag) {
+  const unsigned int cells = g->tile_count;
+  if (depth == cells) return 1;
   if (*stop_flag) return 0;
+  if (nogood_lookup(g)) return 0;
+
   static int check_counter = 0;
   if (++check_counter % 2000 == 0) {
       int message_present = 0;
-      MPI_Iprobe(0, STOP, MPI_COMM_WORLD, &message_present, MPI_STATUS_IGNORE);
+      MPI_Iprobe(0, STOP, g->comm, &message_present, MPI_STATUS_IGNORE);
       if (message_present) {
           *stop_flag = 1;
           return 0;
       }
   }
-  
-  tile_list *candidate_list = game->color_buckets[required_color];
-  for (unsigned int i = 0; i < candidate_list->count; i++) {
-    tile *tile = candidate_list->tiles[i];
-    if (tile->used) continue;
-    
-    tile->used = 1;
-    for (int rot = 0; rot < 4; rot++) {
-      tile->rotation = rot;
-      if (valid_move(game, x, y, tile)) {
-        game->board[y][x] = tile;
-        unsigned int nx, ny;
-        unsigned int next_required_color = 0;
-        ny = nx = game->size;
-
-        if (y < game->size - 1 && game->board[y + 1][x] == NULL && (x == 0 || game->board[y][x - 1] != NULL)) {
-          nx = x; ny = y + 1;
-          next_required_color = S_COLOR(tile);
-        } else if (x < game->size - 1 && game->board[y][x + 1] == NULL) {
-          nx = x + 1; ny = y;
-          next_required_color = E_COLOR(tile);
-        } else if (y > 0 && game->board[y - 1][x] == NULL) {
-          nx = x; ny = y - 1;
-          next_required_color = N_COLOR(tile);
-        } else if (x > 0 && game->board[y][x - 1] == NULL) {
-          nx = x - 1; ny = y;
-          next_required_color = W_COLOR(tile);
-        } else {
-          ny = game->size;
-        }
 
-        if (ny == game->size || play_inversa(game, nx, ny, next_required_color, stop_flag)) {
-          return 1;
-        }
-        game->board[y][x] = NULL;
+  if (cells - depth <= g->endgame) {
+    if (solve_endgame(g, order + depth, cells - depth)) return 1;
+    if (!*stop_flag) nogood_store(g);
+    return 0;
+  }
+
+  const visit *v = &order[depth];
+  unsigned int req[4];
+  tile_list *candidate_list = visit_requirements(g, v, req);
+  unsigned long long valid[candidate_list->count / 16 + 1];
+  filter_masked(candidate_list, req, valid);
+
+  for (unsigned int w = 0; w <= candidate_list->count / 16; w++) {
+    while (valid[w]) {
+      unsigned int k = w * 64 + __builtin_ctzll(valid[w]);
+      valid[w] &= valid[w] - 1;
+      tile *tile = candidate_list->tiles[k / 4];
+      if (tile->used) continue;
+
+      tile->used = 1;
+      tile->rotation = k % 4;
+      *v->slot = tile;
+      zobrist_toggle(g, v->x, v->y, tile);
+      if (play_table(g, order, depth + 1, stop_flag)) {
+        return 1;
       }
+      zobrist_toggle(g, v->x, v->y, tile);
+      *v->slot = NULL;
+      tile->used = 0;
+      if (g->ordering == ORDER_FAILS) tile->fails++;
     }
-    tile->used = 0;
   }
+
+  if (!*stop_flag) nogood_store(g);
   return 0;
 }
 
@@ -314,138 +976,2190 @@ int play_first(game *g, int vertex_choice, int *stop_flag) {
     tile *start_tile;
     unsigned int x = 0, y = 0;
 
+    // Canto fixado por uma dica: a busca começa direto na primeira célula livre da ordem
+    if (g->board[0][0] != NULL) {
+        if (vertex_choice % 4 != 0) return 0;
+        return play_table(g, g->spiral[vertex_choice >= 4], g->clues, stop_flag);
+    }
+
     if (vertex_choice >= 0 && vertex_choice <= 3) {
         if ((unsigned int)vertex_choice >= g->tiles_vertice->count) return 0;
         start_tile = g->tiles_vertice->tiles[vertex_choice];
-        unsigned int nx = 1, ny = 0;
+        if (start_tile->used) return 0; // peça fixada em outro canto
         for (int rot = 0; rot < 4; rot++) {
             start_tile->rotation = rot;
             if (valid_move(g, x, y, start_tile)) {
                 g->board[y][x] = start_tile;
                 start_tile->used = 1;
-                unsigned int next_required_color = E_COLOR(start_tile);
-                if (play(g, nx, ny, next_required_color, stop_flag)) return 1;
+                zobrist_toggle(g, x, y, start_tile);
+                if (play_table(g, g->spiral[0], g->clues + 1, stop_flag)) return 1;
+                zobrist_toggle(g, x, y, start_tile);
                 g->board[y][x] = NULL;
                 start_tile->used = 0;
+                reorder_buckets(g);
             }
         }
     } else if (vertex_choice >= 4 && vertex_choice <= 7) {
         int mapped_choice = vertex_choice - 4;
         if ((unsigned int)mapped_choice >= g->tiles_vertice->count) return 0;
         start_tile = g->tiles_vertice->tiles[mapped_choice];
-        unsigned int nx = 0, ny = 1;
+        if (start_tile->used) return 0;
         for (int rot = 0; rot < 4; rot++) {
             start_tile->rotation = rot;
             if (valid_move(g, x, y, start_tile)) {
                 g->board[y][x] = start_tile;
                 start_tile->used = 1;
-                unsigned int next_required_color = S_COLOR(start_tile);
-                if (play_inversa(g, nx, ny, next_required_color, stop_flag)) return 1;
+                zobrist_toggle(g, x, y, start_tile);
+                if (play_table(g, g->spiral[1], g->clues + 1, stop_flag)) return 1;
+                zobrist_toggle(g, x, y, start_tile);
                 g->board[y][x] = NULL;
                 start_tile->used = 0;
+                reorder_buckets(g);
             }
         }
     }
     return 0;
 }
 
-// Lógica do P0: Enviar dados para os outros processadores e gerenciar a execução
-void master_process(game *g, int mpi_size) {
-    double start_time, end_time;
-    int tot_tasks = 8, next_task = 0, workers_finished = 0, solution_found = 0;
-    
-    MPI_Barrier(MPI_COMM_WORLD);
-    start_time = MPI_Wtime();
+// ---------------------------------------------------------------------------------------------
+// Cobertura exata com Dancing Links: o algoritmo X de Knuth na versão com cores (algoritmo C).
+// Itens primários são as células e as peças, cobertos exatamente uma vez cada. Itens secundários
+// são as arestas internas: a primeira opção que toca uma aresta define a sua cor e as opções
+// com outra cor nela são escondidas. Cada opção é (célula, peça, rotação) compatível com a borda
+// e com as dicas. Sem dicas o canto (0,0) só aceita a primeira peça de vértice, como em
+// play_first(g, 0), então a contagem é de soluções distintas a menos de rotação do tabuleiro.
+// ---------------------------------------------------------------------------------------------
 
-    // Distribui as tarefas iniciais para os trabalhadores e gerenciar quando uma resposta é encontrada
-    for (int rank = 1; rank < mpi_size; rank++) {
-        if (next_task < tot_tasks) {
-            MPI_Send(&next_task, 1, MPI_INT, rank, WORK, MPI_COMM_WORLD);
-            next_task++;
-        } else {
-            MPI_Send(&next_task, 1, MPI_INT, rank, STOP, MPI_COMM_WORLD); // Nenhuma tarefa para este
-        }
-    }
+typedef struct {
+  int *llink, *rlink;                 // Lista dos itens primários ainda não cobertos (cabeça 0)
+  int *top, *ulink, *dlink, *color;   // Nós; no cabeçalho de cada item, top é o tamanho da coluna
+  int *option;                        // Opção de cada nó
+  unsigned int *option_cell, *option_tile;
+  unsigned char *option_rot;
+  int *choice;                        // Nó escolhido em cada nível
+  unsigned int split_depth;           // Nível em que os ramos são divididos entre processos
+  long long branch;                   // Ramo desse nível a explorar (-1 só conta os ramos)
+  long long branch_counter;
+  int count_all;                      // Conta todas as soluções em vez de parar na primeira
+  unsigned long long solutions;
+  int *stop_flag;                     // Vira 1 quando o P0 manda STOP
+} dlx;
 
-    while (workers_finished < (mpi_size - 1)) {
-        
-        // A função Probe foi uma sugestão do GPT de como passar mensagens de modo não bloqueante através de Tags
-        MPI_Status status;
-        MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
-        
-        if (status.MPI_TAG == FOUND) {
-            int num_tiles = g->size * g->size;
-            solution_tile* final_solution = malloc(num_tiles * sizeof(solution_tile));
-            MPI_Recv(final_solution, num_tiles * sizeof(solution_tile), MPI_BYTE, status.MPI_SOURCE, FOUND, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-            
-            if (!solution_found) {
-                solution_found = 1;
-                end_time = MPI_Wtime();
-                //printf("SOLUÇÃO ENCONTRADA (pelo trabalhador %d):\n", status.MPI_SOURCE);
-                print_solution(final_solution, g->size);
-                //printf("\nTempo de execução: %f segundos\n", end_time - start_time);
-                
-                // Manda parar todos os trabalhadores
-                for (int rank = 1; rank < mpi_size; rank++) {
-                    MPI_Send(&next_task, 1, MPI_INT, rank, STOP, MPI_COMM_WORLD);
-                }
-            }
-            free(final_solution);
-            workers_finished++;
+// Item da aresta interna do lado side da célula (x, y), ou 0 na borda
+unsigned int dlx_edge_item(game *g, unsigned int x, unsigned int y, int side) {
+  unsigned int base = 2 * g->tile_count + 1, n = g->size;
+  switch (side) {
+    case 0: return y == 0 ? 0 : base + V_EDGE(g, x, y - 1);
+    case 1: return x == n - 1 ? 0 : base + H_EDGE(g, x, y);
+    case 2: return y == n - 1 ? 0 : base + V_EDGE(g, x, y);
+    default: return x == 0 ? 0 : base + H_EDGE(g, x - 1, y);
+  }
+}
 
-        } else if (status.MPI_TAG == FAIL) {
-            int task_completed;
-            MPI_Recv(&task_completed, 1, MPI_INT, status.MPI_SOURCE, FAIL, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+// Se a peça t na rotação rot vira opção da célula (x, y)
+int dlx_allowed(game *g, unsigned int x, unsigned int y, tile *t, int rot) {
+  tile *fixed = g->board[y][x];
+  if (fixed != NULL) return fixed == t && fixed->rotation == rot;
+  if (t->used) return 0;
+  if (g->clues == 0 && x == 0 && y == 0 && g->size > 1 && g->tiles_vertice->count > 0 &&
+      t != g->tiles_vertice->tiles[0]) return 0;
+  t->rotation = rot;
+  return valid_move(g, x, y, t);
+}
 
-            if (solution_found) {
-                workers_finished++;
-            } else {
-                MPI_Send(&next_task, 1, MPI_INT, status.MPI_SOURCE, STOP, MPI_COMM_WORLD);
-                workers_finished++;
-            }
+// Monta a matriz esparsa a partir do jogo já inicializado (com as dicas no tabuleiro)
+dlx *build_dlx(game *g, int count_all) {
+  unsigned int n = g->size, cells = g->tile_count;
+  unsigned int items = 2 * cells + 2 * n * (n - 1);
+  unsigned int options = 0, nodes = items + 2;
+
+  for (unsigned int c = 0; c < cells; c++)
+    for (unsigned int i = 0; i < g->tile_count; i++)
+      for (int rot = 0; rot < 4; rot++) {
+        if (!dlx_allowed(g, c % n, c / n, &g->tiles[i], rot)) continue;
+        options++;
+        nodes += 3;
+        for (int s = 0; s < 4; s++) nodes += dlx_edge_item(g, c % n, c / n, s) != 0;
+      }
+
+  dlx *d = calloc(1, sizeof(dlx));
+  assert(d != NULL);
+  d->llink = malloc((items + 1) * sizeof(int));
+  d->rlink = malloc((items + 1) * sizeof(int));
+  d->top = malloc(nodes * sizeof(int));
+  d->ulink = malloc(nodes * sizeof(int));
+  d->dlink = malloc(nodes * sizeof(int));
+  d->color = calloc(nodes, sizeof(int));
+  d->option = calloc(nodes, sizeof(int));
+  d->option_cell = malloc((options + 1) * sizeof(unsigned int));
+  d->option_tile = malloc((options + 1) * sizeof(unsigned int));
+  d->option_rot = malloc(options + 1);
+  d->choice = malloc((cells + 1) * sizeof(int));
+  assert(d->llink && d->rlink && d->top && d->ulink && d->dlink && d->color && d->option &&
+         d->option_cell && d->option_tile && d->option_rot && d->choice);
+  d->split_depth = cells + 1;
+  d->branch = -1;
+  d->count_all = count_all;
+
+  // Só os itens primários (1..2 * cells) entram na lista; os secundários apontam para si mesmos
+  for (unsigned int i = 0; i <= items; i++) {
+    d->llink[i] = (i == 0) ? (int)(2 * cells) : (i <= 2 * cells ? (int)i - 1 : (int)i);
+    d->rlink[i] = (i == 2 * cells) ? 0 : (i < 2 * cells ? (int)i + 1 : (int)i);
+    d->top[i] = 0;
+    d->ulink[i] = d->dlink[i] = i;
+  }
+
+  // Cada opção é seguida de um espaçador: ulink aponta para o primeiro nó da opção anterior e
+  // dlink para o último nó da próxima
+  int p = items + 1, spacer = p, o = 0;
+  d->top[p] = 0;
+  for (unsigned int c = 0; c < cells; c++)
+    for (unsigned int i = 0; i < g->tile_count; i++)
+      for (int rot = 0; rot < 4; rot++) {
+        tile *t = &g->tiles[i];
+        if (!dlx_allowed(g, c % n, c / n, t, rot)) continue;
+        int first = p + 1;
+        unsigned int row[6], colors[6], len = 0;
+        row[len] = 1 + c; colors[len++] = 0;
+        row[len] = 1 + cells + i; colors[len++] = 0;
+        t->rotation = rot;
+        for (int s = 0; s < 4; s++) {
+          unsigned int item = dlx_edge_item(g, c % n, c / n, s);
+          if (item) { row[len] = item; colors[len++] = X_COLOR(t, s) + 1; }
         }
+        for (unsigned int k = 0; k < len; k++) {
+          p++;
+          d->top[p] = row[k];
+          d->color[p] = colors[k];
+          d->option[p] = o;
+          d->ulink[p] = d->ulink[row[k]];
+          d->dlink[p] = row[k];
+          d->dlink[d->ulink[row[k]]] = p;
+          d->ulink[row[k]] = p;
+          d->top[row[k]]++;
+        }
+        d->dlink[spacer] = p;
+        p++;
+        d->top[p] = -(o + 1);
+        d->ulink[p] = first;
+        spacer = p;
+        d->option_cell[o] = c;
+        d->option_tile[o] = i;
+        d->option_rot[o] = rot;
+        o++;
+      }
+  assert((unsigned int)p < nodes);
+  return d;
+}
+
+void free_dlx(dlx *d) {
+  free(d->llink); free(d->rlink);
+  free(d->top); free(d->ulink); free(d->dlink); free(d->color); free(d->option);
+  free(d->option_cell); free(d->option_tile); free(d->option_rot);
+  free(d->choice);
+  free(d);
+}
+
+// Tira da matriz as outras linhas da opção do nó p (hide' de Knuth)
+void dlx_hide(dlx *d, int p) {
+  for (int q = p + 1; q != p; ) {
+    int x = d->top[q], u = d->ulink[q], w = d->dlink[q];
+    if (x <= 0) q = u;
+    else {
+      if (d->color[q] >= 0) { d->dlink[u] = w; d->ulink[w] = u; d->top[x]--; }
+      q++;
     }
+  }
+}
 
-    if (!solution_found) {
-        // end_time = MPI_Wtime();
-        printf("SOLUTION NOT FOUND\n");
+void dlx_unhide(dlx *d, int p) {
+  for (int q = p - 1; q != p; ) {
+    int x = d->top[q], u = d->ulink[q], w = d->dlink[q];
+    if (x <= 0) q = w;
+    else {
+      if (d->color[q] >= 0) { d->dlink[u] = q; d->ulink[w] = q; d->top[x]++; }
+      q--;
     }
+  }
 }
 
-// Lógica dos Outros Processadores: Inicia o Processo de busca de uma solução e o encerra
-void worker_process(game *g) {
-    int stop_flag = 0;
-    MPI_Barrier(MPI_COMM_WORLD);
+void dlx_cover(dlx *d, int i) {
+  for (int p = d->dlink[i]; p != i; p = d->dlink[p]) dlx_hide(d, p);
+  d->rlink[d->llink[i]] = d->rlink[i];
+  d->llink[d->rlink[i]] = d->llink[i];
+}
 
-    while(!stop_flag) {
-        int task_id;
-        MPI_Status status;
-        MPI_Recv(&task_id, 1, MPI_INT, 0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+void dlx_uncover(dlx *d, int i) {
+  d->rlink[d->llink[i]] = i;
+  d->llink[d->rlink[i]] = i;
+  for (int p = d->ulink[i]; p != i; p = d->ulink[p]) dlx_unhide(d, p);
+}
+
+// Fixa a cor do item secundário do nó p: esconde as opções com outra cor e marca com -1 as de
+// mesma cor, que já não precisam ser escondidas de novo
+void dlx_purify(dlx *d, int p) {
+  int c = d->color[p], i = d->top[p];
+  for (int q = d->dlink[i]; q != i; q = d->dlink[q]) {
+    if (q == p) continue;
+    if (d->color[q] == c) d->color[q] = -1;
+    else dlx_hide(d, q);
+  }
+}
+
+void dlx_unpurify(dlx *d, int p) {
+  int c = d->color[p], i = d->top[p];
+  for (int q = d->ulink[i]; q != i; q = d->ulink[q]) {
+    if (q == p) continue;
+    if (d->color[q] < 0) d->color[q] = c;
+    else dlx_unhide(d, q);
+  }
+}
+
+void dlx_commit(dlx *d, int p, int j) {
+  if (d->color[p] == 0) dlx_cover(d, j);
+  else if (d->color[p] > 0) dlx_purify(d, p);
+}
+
+void dlx_uncommit(dlx *d, int p, int j) {
+  if (d->color[p] == 0) dlx_uncover(d, j);
+  else if (d->color[p] > 0) dlx_unpurify(d, p);
+}
+
+// Busca recursiva escolhendo sempre o item primário com menos opções. No nível split_depth
+// só o ramo de número branch é explorado, que é como os ramos viram unidades de trabalho. Retorna 1 ao achar uma solução (que fica no
+// tabuleiro); no modo count_all percorre tudo e soma em solutions.
+int dlx_search(dlx *d, game *g, unsigned int level) {
+  if (*d->stop_flag) return 0;
+  static int check_counter = 0;
+  if (++check_counter % 2000 == 0) {
+      int message_present = 0;
+      MPI_Iprobe(0, STOP, g->comm, &message_present, MPI_STATUS_IGNORE);
+      if (message_present) {
+          *d->stop_flag = 1;
+          return 0;
+      }
+  }
+  if (level == d->split_depth && d->branch_counter++ != d->branch) return 0;
+  if (d->rlink[0] == 0) {
+    if (d->count_all) {
+      d->solutions++;
+      return 0;
+    }
+    for (unsigned int l = 0; l < level; l++) {
+      int o = d->option[d->choice[l]];
+      tile *t = &g->tiles[d->option_tile[o]];
+      t->rotation = d->option_rot[o];
+      t->used = 1;
+      g->board[d->option_cell[o] / g->size][d->option_cell[o] % g->size] = t;
+    }
+    return 1;
+  }
+
+  int best = 0;
+  for (int i = d->rlink[0]; i != 0; i = d->rlink[i])
+    if (best == 0 || d->top[i] < d->top[best]) best = i;
+  if (d->top[best] == 0) return 0;
+
+  int found = 0;
+  dlx_cover(d, best);
+  for (int x = d->dlink[best]; x != best && !found && !*d->stop_flag; x = d->dlink[x]) {
+    for (int p = x + 1; p != x; ) {
+      int j = d->top[p];
+      if (j <= 0) p = d->ulink[p];
+      else { dlx_commit(d, p, j); p++; }
+    }
+    d->choice[level] = x;
+    found = dlx_search(d, g, level + 1);
+    for (int p = x - 1; p != x; ) {
+      int j = d->top[p];
+      if (j <= 0) p = d->dlink[p];
+      else { dlx_uncommit(d, p, j); p--; }
+    }
+  }
+  dlx_uncover(d, best);
+  return found;
+}
+
+// Escolhe o nível de divisão do P0: o primeiro com pelo menos target ramos, que são contados
+// rodando a busca até esse nível. Retorna o número de ramos do nível escolhido.
+long long dlx_plan(dlx *d, game *g, unsigned int target) {
+  for (unsigned int depth = 0; ; depth++) {
+    d->split_depth = depth;
+    d->branch = -1;
+    d->branch_counter = 0;
+    dlx_search(d, g, 0);
+    if (d->branch_counter >= target || d->branch_counter == 0 || depth >= g->tile_count)
+      return d->branch_counter;
+  }
+}
+
+// Relógio das sondas do modo automático, em segundos
+double probe_clock(void) {
+  return MPI_Wtime();
+}
+
+// ---------------------------------------------------------------------------------------------
+// Modo automático (-s auto): perfila os buckets de cor, roda sondas curtas de cada configuração
+// candidata (heurística de ordenação x sentido da espiral x peça do canto) e dá o resto da busca
+// à que avançou mais rápido. O progresso de uma sonda é a fração da árvore já descartada pela
+// busca em profundidade: soma de (ramos terminados / ramos) em cada nível do caminho atual,
+// ponderada pelo produto de 1 / ramos dos níveis de cima. Progresso / tempo dá a taxa, e o
+// inverso da taxa é a previsão de tempo para percorrer a árvore toda.
+// ---------------------------------------------------------------------------------------------
+
+#define AUTO_PROBE_SECONDS 0.02 // Duração de cada sonda
+#define AUTO_SPREAD_MIN 0.5     // Abaixo disso as cores são uniformes e ORDER_RARE não muda nada
+#define AUTO_MAX_PROBES 24      // 3 ordenações x 8 tarefas de play_first
+
+static const char *ordering_names[] = {"id", "rare", "constraint", "fails"};
+
+typedef struct {
+  int ordering;
+  int vertex_choice;
+  unsigned long long nodes;
+  unsigned int max_depth;
+  double progress;
+  double seconds;
+  double rate; // progresso por segundo
+  int status;  // 0 sem resposta no prazo, 1 achou solução, 2 esgotou sem solução
+} auto_probe;
+
+typedef struct {
+  double deadline;
+  unsigned long long nodes;
+  unsigned int max_depth;
+  unsigned int stop_depth;      // nível em que o prazo estourou
+  int expired;
+  unsigned int *done, *width;   // ramos terminados e ramos válidos de cada nível do caminho
+} probe_state;
+
+// Perfil do quebra-cabeça a partir dos buckets de create_color_list: tamanhos e a dispersão
+// ((maior - menor) / média) da frequência das cores internas, que é retornada
+double profile_colors(game *g, int report) {
+  unsigned int min = g->tile_count * 4, max = 0, used = 0;
+  double sum = 0;
+  for (unsigned int c = 1; c < g->ncolors; c++) {
+    unsigned int count = g->color_buckets[c]->count;
+    if (count == 0) continue;
+    used++;
+    if (count < min) min = count;
+    if (count > max) max = count;
+    sum += count;
+  }
+  double mean = used ? sum / used : 0;
+  double spread = mean > 0 ? (max - min) / mean : 0;
+  if (report)
+    fprintf(stderr, "Perfil: %u cores internas, buckets de %u a %u peças (média %.1f, dispersão %.2f), "
+            "%u peças de borda, %u de vértice, %u dicas\n", used, used ? min : 0, max, mean, spread,
+            g->color_buckets[0]->count, g->tiles_vertice->count, g->clues);
+  return spread;
+}
+
+// Configurações candidatas. ORDER_FAILS fica de fora porque começa igual a ORDER_ID e só se
+// adapta entre subárvores da raiz, o que uma sonda curta não chega a ver.
+int auto_candidates(game *g, double spread, auto_probe *probes) {
+  int orderings[3] = {ORDER_ID, ORDER_CONSTRAINT, ORDER_RARE};
+  int norderings = spread >= AUTO_SPREAD_MIN ? 3 : 2, n = 0;
+  for (int o = 0; o < norderings; o++)
+    for (int v = 0; v < 8; v++) {
+      if (g->board[0][0] != NULL ? v % 4 != 0 : ((unsigned int)(v % 4) >= g->tiles_vertice->count ||
+                                                  g->tiles_vertice->tiles[v % 4]->used)) continue;
+      memset(&probes[n], 0, sizeof(auto_probe));
+      probes[n].ordering = orderings[o];
+      probes[n].vertex_choice = v;
+      n++;
+    }
+  return n;
+}
+
+// Mesma busca de play_table, sem hash nem nogoods, parando no prazo
+int probe_search(game *g, const visit *order, unsigned int depth, probe_state *pr) {
+  if (depth == g->tile_count) return 1;
+  if ((++pr->nodes & 1023) == 0 && probe_clock() > pr->deadline) pr->expired = 1;
+  if (pr->expired) {
+    pr->stop_depth = depth;
+    return 0;
+  }
+  if (depth > pr->max_depth) pr->max_depth = depth;
+
+  const visit *v = &order[depth];
+  unsigned int req[4];
+  tile_list *candidate_list = visit_requirements(g, v, req);
+  unsigned long long valid[candidate_list->count / 16 + 1];
+  filter_masked(candidate_list, req, valid);
+
+  pr->width[depth] = 0;
+  pr->done[depth] = 0;
+  for (unsigned int k = 0; k < candidate_list->count * 4; k++)
+    if ((valid[k / 64] >> (k % 64)) & 1 && !candidate_list->tiles[k / 4]->used) pr->width[depth]++;
+
+  for (unsigned int k = 0; k < candidate_list->count * 4; k++) {
+    tile *tile = candidate_list->tiles[k / 4];
+    if (!((valid[k / 64] >> (k % 64)) & 1) || tile->used) continue;
+    tile->used = 1;
+    tile->rotation = k % 4;
+    *v->slot = tile;
+    if (probe_search(g, order, depth + 1, pr)) return 1;
+    *v->slot = NULL;
+    tile->used = 0;
+    if (pr->expired) return 0;
+    pr->done[depth]++;
+  }
+  return 0;
+}
+
+// Fração da árvore descartada entre os níveis first e stop_depth do caminho da sonda
+double probe_progress(const probe_state *pr, unsigned int first) {
+  double progress = 0, weight = 1;
+  for (unsigned int d = first; d < pr->stop_depth && pr->width[d] > 0; d++) {
+    progress += weight * pr->done[d] / pr->width[d];
+    weight /= pr->width[d];
+  }
+  return progress;
+}
+
+// Roda uma sonda. Se ela achar a solução, o tabuleiro fica preenchido e retorna 1.
+int run_probe(game *g, auto_probe *p, double seconds) {
+  probe_state pr;
+  memset(&pr, 0, sizeof(pr));
+  pr.done = calloc(g->tile_count + 1, sizeof(unsigned int));
+  pr.width = calloc(g->tile_count + 1, sizeof(unsigned int));
+  assert(pr.done != NULL && pr.width != NULL);
+
+  g->ordering = p->ordering;
+  order_candidates(g);
+  const visit *order = g->spiral[p->vertex_choice >= 4];
+  double start = probe_clock();
+  pr.deadline = start + seconds;
+  int found = 0;
+
+  if (g->board[0][0] != NULL) {
+    found = probe_search(g, order, g->clues, &pr);
+    p->progress = pr.expired ? probe_progress(&pr, g->clues) : 1;
+  } else {
+    // A peça do canto é o primeiro nível: cada rotação válida é um ramo
+    tile *start_tile = g->tiles_vertice->tiles[p->vertex_choice % 4];
+    unsigned int rotations = 0, finished = 0;
+    for (int rot = 0; rot < 4; rot++) {
+      start_tile->rotation = rot;
+      rotations += valid_move(g, 0, 0, start_tile);
+    }
+    for (int rot = 0; rot < 4 && !found && !pr.expired; rot++) {
+      start_tile->rotation = rot;
+      if (!valid_move(g, 0, 0, start_tile)) continue;
+      start_tile->used = 1;
+      g->board[0][0] = start_tile;
+      found = probe_search(g, order, g->clues + 1, &pr);
+      if (found) break;
+      g->board[0][0] = NULL;
+      start_tile->used = 0;
+      if (!pr.expired) finished++;
+    }
+    double inner = pr.expired ? probe_progress(&pr, g->clues + 1) : 0;
+    p->progress = rotations ? (finished + inner) / rotations : 1;
+  }
+
+  p->seconds = probe_clock() - start;
+  p->nodes = pr.nodes;
+  p->max_depth = pr.max_depth;
+  p->status = found ? 1 : (pr.expired ? 0 : 2);
+  p->rate = p->progress / (p->seconds > 1e-9 ? p->seconds : 1e-9);
+  free(pr.done);
+  free(pr.width);
+  return found;
+}
+
+void report_probe(const auto_probe *p) {
+  static const char *status[] = {"no prazo", "achou solução", "esgotou"};
+  fprintf(stderr, "Sonda: ordem %s, %s, canto %d: %llu nós, profundidade %u, progresso %.3e em %.3f s "
+          "(%.3e/s, %s)\n", ordering_names[p->ordering], p->vertex_choice >= 4 ? "inversa" : "espiral",
+          p->vertex_choice % 4, p->nodes, p->max_depth, p->progress, p->seconds, p->rate, status[p->status]);
+}
+
+// Cantos (bit c = peça de vértice c) cuja árvore alguma sonda percorreu inteira sem solução.
+// A sonda não usa nogoods, então o canto não tem solução em nenhum sentido nem ordenação.
+unsigned int auto_exhausted(const auto_probe *probes, int n) {
+  unsigned int exhausted = 0;
+  for (int i = 0; i < n; i++)
+    if (probes[i].status == 2) exhausted |= 1u << (probes[i].vertex_choice % 4);
+  return exhausted;
+}
+
+// Sem dicas cada canto é a busca inteira (girar uma solução leva qualquer peça de vértice ao
+// (0,0)), assim como com o canto fixado por uma dica; com dicas e o canto livre, todos os cantos
+// possíveis precisam ter esgotado para provar que não há solução.
+int auto_unsolvable(game *g, unsigned int exhausted) {
+  if (exhausted && (g->clues == 0 || g->board[0][0] != NULL)) return 1;
+  if (g->board[0][0] != NULL) return 0;
+  for (unsigned int c = 0; c < 4 && c < g->tiles_vertice->count; c++)
+    if (!g->tiles_vertice->tiles[c]->used && !(exhausted >> c & 1)) return 0;
+  return 1;
+}
+
+// Escolhe a sonda vencedora: uma que achou solução, senão a de maior taxa de progresso entre as
+// que não esgotaram (rodar de novo uma árvore já esgotada não acharia nada)
+int auto_winner(const auto_probe *probes, int n) {
+  int best = -1;
+  for (int i = 0; i < n; i++) {
+    if (best >= 0 && probes[best].status == 1) break;
+    if (probes[i].status == 2) continue;
+    if (best < 0 || probes[i].status == 1 || probes[i].rate > probes[best].rate) best = i;
+  }
+  if (best < 0) return -1;
+  const auto_probe *p = &probes[best];
+  fprintf(stderr, "Escolha: ordem %s, %s, canto %d entre %d configurações", ordering_names[p->ordering],
+          p->vertex_choice >= 4 ? "inversa" : "espiral", p->vertex_choice % 4, n);
+  if (p->rate > 0) fprintf(stderr, " (ETA %.3f s pela taxa)\n", 1 / p->rate);
+  else fprintf(stderr, " (sem progresso medido)\n");
+  return best;
+}
+
+#define AUTO_SOLVED -2      // auto_select: uma sonda achou a solução
+#define AUTO_NO_SOLUTION -3 // auto_select: as sondas esgotadas provam que não há solução
+
+// Sondas em paralelo entre os processos de g->comm (mpi_rank e mpi_size são os deste
+// comunicador): a configuração i roda no processo i % mpi_size, o P0 incluído, e os
+// resultados são juntados no P0 com MPI_Reduce (cada posição só é preenchida por um processo,
+// então MAX combina). O P0 relata e escolhe; todos aplicam a ordenação vencedora. Retorna o
+// vertex_choice vencedor, -1 sem candidatas, AUTO_SOLVED se uma sonda achou a solução (que o
+// processo dela manda ao P0 em solution) ou AUTO_NO_SOLUTION se as sondas esgotadas já
+// provam que não há solução. solution precisa ter tile_count posições em todos os processos.
+int auto_select(game *g, int mpi_rank, int mpi_size, solution_tile *solution) {
+  auto_probe probes[AUTO_MAX_PROBES];
+  double local[AUTO_MAX_PROBES * 6], merged[AUTO_MAX_PROBES * 6];
+  int n = auto_candidates(g, profile_colors(g, mpi_rank == 0), probes);
+  int found = -1; // sonda deste processo que achou solução
+
+  memset(local, 0, sizeof(local));
+  for (int i = 0; i < n; i++) {
+    if (mpi_rank != i % mpi_size || found >= 0) continue;
+    if (run_probe(g, &probes[i], AUTO_PROBE_SECONDS)) {
+      // Guarda a solução e desfaz o tabuleiro, que ainda pode receber outras sondas
+      pack_solution(g, solution);
+      found = i;
+      const visit *order = g->spiral[0];
+      for (unsigned int d = g->clues; d < g->tile_count; d++) {
+        g->board[order[d].y][order[d].x]->used = 0;
+        g->board[order[d].y][order[d].x] = NULL;
+      }
+    }
+    double *f = &local[i * 6];
+    f[0] = (double)probes[i].nodes; f[1] = probes[i].max_depth; f[2] = probes[i].progress;
+    f[3] = probes[i].seconds; f[4] = probes[i].rate; f[5] = probes[i].status;
+  }
+  MPI_Reduce(local, merged, n * 6, MPI_DOUBLE, MPI_MAX, 0, g->comm);
+
+  int decision[2] = {0, 0}; // sonda vencedora e resultado (vertex_choice, AUTO_SOLVED ou AUTO_NO_SOLUTION)
+  if (mpi_rank == 0 && n > 0) {
+    for (int i = 0; i < n; i++) {
+      double *f = &merged[i * 6];
+      probes[i].nodes = (unsigned long long)f[0]; probes[i].max_depth = (unsigned int)f[1];
+      probes[i].progress = f[2]; probes[i].seconds = f[3]; probes[i].rate = f[4]; probes[i].status = (int)f[5];
+      if (f[3] > 0 || f[5] > 0) report_probe(&probes[i]);
+    }
+    if (auto_unsolvable(g, auto_exhausted(probes, n))) {
+      fprintf(stderr, "As sondas esgotaram a árvore: não há solução\n");
+      decision[1] = AUTO_NO_SOLUTION;
+    } else {
+      decision[0] = auto_winner(probes, n);
+      decision[1] = probes[decision[0]].status == 1 ? AUTO_SOLVED : probes[decision[0]].vertex_choice;
+    }
+  }
+  MPI_Bcast(decision, 2, MPI_INT, 0, g->comm);
+  if (n == 0) return -1;
+  if (decision[1] == AUTO_SOLVED) {
+    // A sonda vencedora é a primeira que achou; o processo dela manda o tabuleiro ao P0
+    int owner = decision[0] % mpi_size;
+    if (owner != 0 && mpi_rank == owner)
+      MPI_Send(solution, g->tile_count * sizeof(solution_tile), MPI_BYTE, 0, FOUND, g->comm);
+    else if (owner != 0 && mpi_rank == 0)
+      MPI_Recv(solution, g->tile_count * sizeof(solution_tile), MPI_BYTE, owner, FOUND, g->comm,
+               MPI_STATUS_IGNORE);
+    return AUTO_SOLVED;
+  }
+  if (decision[1] == AUTO_NO_SOLUTION) return AUTO_NO_SOLUTION;
+  g->ordering = probes[decision[0]].ordering;
+  order_candidates(g);
+  return decision[1];
+}
+
+// ---------------------------------------------------------------------------------------------
+// Estimativa do tamanho da árvore de busca (método de Knuth): cada amostra desce por um caminho
+// aleatório seguindo a ordem de visita da espiral e soma os produtos do número de filhos
+// válidos em cada nível. A média das amostras é um estimador sem viés do número de nós.
+// O P0 usa as estimativas para dividir as subárvores grandes e juntar as pequenas, de modo que
+// as unidades de trabalho enviadas aos trabalhadores tenham tamanhos parecidos.
+// ---------------------------------------------------------------------------------------------
+
+// Estima os nós da subárvore a partir do estado atual, com as depth primeiras células de order
+// já colocadas. nodes recebe quantos nós as amostras expandiram, para medir o custo por nó.
+double estimate_subtree(game *g, const visit *order, unsigned int depth, unsigned int probes,
+                        unsigned long long *seed, unsigned long long *nodes) {
+  double total = 0;
+  tile **path = malloc(g->tile_count * sizeof(tile*));
+  unsigned int *choices = malloc(g->tile_count * 4 * sizeof(unsigned int));
+  assert(path != NULL && choices != NULL);
+
+  for (unsigned int p = 0; p < probes; p++) {
+    double estimate = 1, width = 1;
+    unsigned int d = depth;
+    while (d < g->tile_count) {
+      const visit *v = &order[d];
+      tile_list *candidate_list = g->color_buckets[visit_color(g, v)];
+      unsigned long long valid[candidate_list->count / 16 + 1];
+      unsigned int n = 0;
+      filter_candidates(g, candidate_list, v->x, v->y, valid);
+      for (unsigned int k = 0; k < candidate_list->count * 4; k++)
+        if ((valid[k / 64] >> (k % 64)) & 1 && !candidate_list->tiles[k / 4]->used) choices[n++] = k;
+      (*nodes)++;
+      if (n == 0) break;
+
+      width *= n;
+      estimate += width;
+      unsigned int k = choices[splitmix64(seed) % n];
+      tile *t = candidate_list->tiles[k / 4];
+      t->rotation = k % 4;
+      t->used = 1;
+      g->board[v->y][v->x] = t;
+      path[d++] = t;
+    }
+    while (d > depth) {
+      d--;
+      path[d]->used = 0;
+      g->board[order[d].y][order[d].x] = NULL;
+    }
+    total += estimate;
+  }
+
+  free(path);
+  free(choices);
+  return probes ? total / probes : 0;
+}
+
+// Estima os nós de play_first(g, vertex_choice), somando as rotações válidas da peça inicial
+double estimate_task(game *g, int vertex_choice, unsigned int probes, unsigned long long *seed,
+                     unsigned long long *nodes) {
+  const visit *order = g->spiral[vertex_choice >= 4];
+  if (g->board[0][0] != NULL)
+    return vertex_choice % 4 ? 0 : estimate_subtree(g, order, g->clues, probes, seed, nodes);
+  if ((unsigned int)(vertex_choice % 4) >= g->tiles_vertice->count) return 0;
+  tile *start_tile = g->tiles_vertice->tiles[vertex_choice % 4];
+  if (start_tile->used) return 0;
+  double estimate = 0;
+
+  start_tile->used = 1;
+  for (int rot = 0; rot < 4; rot++) {
+    start_tile->rotation = rot;
+    if (!valid_move(g, 0, 0, start_tile)) continue;
+    g->board[0][0] = start_tile;
+    estimate += estimate_subtree(g, order, g->clues + 1, probes, seed, nodes);
+    g->board[0][0] = NULL;
+  }
+  start_tile->used = 0;
+  return estimate;
+}
+
+// Coloca (place = 1) ou retira (place = 0) as células fixadas da subtarefa
+void apply_prefix(game *g, const subtask *t, int place) {
+    const visit *order = g->spiral[t->vertex_choice >= 4] + g->clues;
+    for (unsigned int i = 0; i < t->depth; i++) {
+        unsigned int d = place ? i : t->depth - 1 - i;
+        tile *tl = &g->tiles[t->prefix[d] / 4];
+        if (place) {
+            tl->rotation = t->prefix[d] % 4;
+            tl->used = 1;
+            g->board[order[d].y][order[d].x] = tl;
+            zobrist_toggle(g, order[d].x, order[d].y, tl);
+        } else {
+            zobrist_toggle(g, order[d].x, order[d].y, tl);
+            g->board[order[d].y][order[d].x] = NULL;
+            tl->used = 0;
+        }
+    }
+}
+
+double estimate_subtask(game *g, const subtask *t, unsigned int probes, unsigned long long *seed,
+                        unsigned long long *nodes) {
+    if (t->depth == 0) return estimate_task(g, t->vertex_choice, probes, seed, nodes);
+    apply_prefix(g, t, 1);
+    double estimate = estimate_subtree(g, g->spiral[t->vertex_choice >= 4], g->clues + t->depth, probes, seed, nodes);
+    apply_prefix(g, t, 0);
+    return estimate;
+}
+
+// Filhos da subtarefa: cada (peça, rotação) válida na próxima célula da ordem de visita
+int expand_subtask(game *g, const subtask *t, subtask *children) {
+    int n = 0;
+    if (t->depth == 0 && g->board[0][0] == NULL) {
+        if ((unsigned int)(t->vertex_choice % 4) >= g->tiles_vertice->count) return 0;
+        tile *start_tile = g->tiles_vertice->tiles[t->vertex_choice % 4];
+        if (start_tile->used) return 0;
+        for (int rot = 0; rot < 4; rot++) {
+            start_tile->rotation = rot;
+            if (!valid_move(g, 0, 0, start_tile)) continue;
+            children[n] = *t;
+            children[n].depth = 1;
+            children[n].prefix[0] = start_tile->id * 4 + rot;
+            n++;
+        }
+        return n;
+    }
+
+    apply_prefix(g, t, 1);
+    const visit *v = &g->spiral[t->vertex_choice >= 4][g->clues + t->depth];
+    tile_list *candidate_list = g->color_buckets[visit_color(g, v)];
+    unsigned long long valid[candidate_list->count / 16 + 1];
+    filter_candidates(g, candidate_list, v->x, v->y, valid);
+    for (unsigned int k = 0; k < candidate_list->count * 4; k++) {
+        tile *tl = candidate_list->tiles[k / 4];
+        if (!((valid[k / 64] >> (k % 64)) & 1) || tl->used) continue;
+        children[n] = *t;
+        children[n].prefix[t->depth] = tl->id * 4 + k % 4;
+        children[n].depth = t->depth + 1;
+        n++;
+    }
+    apply_prefix(g, t, 0);
+    return n;
+}
+
+int compare_subtasks(const void *a, const void *b) {
+    double ea = ((const subtask *)a)->estimate, eb = ((const subtask *)b)->estimate;
+    return (ea < eb) - (ea > eb);
+}
+
+// Planeja as unidades de trabalho do P0. Sem amostras, cada tarefa de play_first é uma unidade,
+// como antes. Com amostras, a maior subárvore é dividida enquanto passar do tamanho alvo
+// (total / (trabalhadores * SPLIT_FACTOR)); depois as pequenas são juntadas até o alvo.
+// Cada unidade é um vetor de inteiros: [n, (vertex_choice, depth, prefixo...) x n].
+int plan_units(game *g, int nworkers, unsigned int probes, int ***units_out, int **lengths_out) {
+    unsigned int capacity = 8 + (unsigned int)nworkers * SPLIT_FACTOR * 8 + 4 * g->tile_count;
+    subtask *tasks = malloc((capacity + 4 * g->tile_count) * sizeof(subtask));
+    subtask *children = malloc(4 * g->tile_count * sizeof(subtask));
+    unsigned long long seed = 0x5EED, nodes = 0;
+    double start = MPI_Wtime(), total = 0;
+    unsigned int n = 0;
+    assert(tasks != NULL && children != NULL);
+
+    for (int v = 0; v < 8; v++) {
+        if ((unsigned int)(v % 4) >= g->tiles_vertice->count) continue;
+        if (g->board[0][0] != NULL && v % 4) continue; // canto fixo: uma tarefa por ordem
+        tasks[n].vertex_choice = v;
+        tasks[n].depth = 0;
+        tasks[n].estimate = probes ? estimate_subtask(g, &tasks[n], probes, &seed, &nodes) : 1;
+        total += tasks[n].estimate;
+        n++;
+    }
+
+    double target = total / (nworkers * SPLIT_FACTOR);
+    while (probes > 0 && n < capacity) {
+        unsigned int largest = n;
+        for (unsigned int i = 0; i < n; i++)
+            if (tasks[i].depth < MAX_PREFIX && g->clues + tasks[i].depth < g->tile_count &&
+                (largest == n || tasks[i].estimate > tasks[largest].estimate))
+                largest = i;
+        if (largest == n || tasks[largest].estimate <= target) break;
+
+        int nchildren = expand_subtask(g, &tasks[largest], children);
+        tasks[largest] = tasks[--n];
+        for (int c = 0; c < nchildren; c++) {
+            children[c].estimate = estimate_subtask(g, &children[c], probes, &seed, &nodes);
+            tasks[n++] = children[c];
+        }
+    }
+
+    if (probes > 0) {
+        double per_node = (MPI_Wtime() - start) / (nodes ? nodes : 1);
+        fprintf(stderr, "Estimativa da árvore completa: %.3e nós, ETA %.3f segundos com %d trabalhadores (%u subárvores)\n",
+                total, total * per_node / nworkers, nworkers, n);
+    }
+
+    // Maiores primeiro; subárvores com menos da metade do alvo são agrupadas
+    qsort(tasks, n, sizeof(subtask), compare_subtasks);
+    int **units = malloc((n + 1) * sizeof(int *));
+    int *lengths = malloc((n + 1) * sizeof(int));
+    int nunits = 0;
+    double pending = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        int fresh = (probes == 0 || tasks[i].estimate >= target / 2 || nunits == 0 || pending >= target);
+        if (fresh) {
+            units[nunits] = malloc(sizeof(int));
+            units[nunits][0] = 0;
+            lengths[nunits] = 1;
+            nunits++;
+            pending = 0;
+        }
+        // Cada subárvore ocupa 2 + depth inteiros; a unidade cresce só o que precisa
+        int len = lengths[nunits - 1];
+        int *unit = realloc(units[nunits - 1], (len + 2 + tasks[i].depth) * sizeof(int));
+        assert(unit != NULL);
+        units[nunits - 1] = unit;
+        unit[0]++;
+        unit[len++] = tasks[i].vertex_choice;
+        unit[len++] = (int)tasks[i].depth;
+        for (unsigned int d = 0; d < tasks[i].depth; d++) unit[len++] = (int)tasks[i].prefix[d];
+        lengths[nunits - 1] = len;
+        if (tasks[i].estimate < target / 2) pending += tasks[i].estimate;
+        else pending = target;
+    }
+
+    free(tasks);
+    free(children);
+    *units_out = units;
+    *lengths_out = lengths;
+    return nunits;
+}
+
+// Executa uma subtarefa: fixa o prefixo e continua a espiral a partir da próxima célula
+int play_subtask(game *g, const subtask *t, int *stop_flag) {
+    if (t->depth == 0) return play_first(g, t->vertex_choice, stop_flag);
+    int inversa = t->vertex_choice >= 4;
+    apply_prefix(g, t, 1);
+    if (g->clues + t->depth == g->tile_count) return 1;
+    int found = play_table(g, g->spiral[inversa], g->clues + t->depth, stop_flag);
+    if (!found) apply_prefix(g, t, 0);
+    return found;
+}
+
+// Executa as subtarefas de uma unidade de trabalho até achar solução ou receber STOP
+int play_unit(game *g, const int *unit, int *stop_flag) {
+    const int *p = unit + 1;
+    for (int i = 0; i < unit[0] && !*stop_flag; i++) {
+        subtask t;
+        t.vertex_choice = *p++;
+        t.depth = (unsigned int)*p++;
+        for (unsigned int d = 0; d < t.depth; d++) t.prefix[d] = (unsigned int)*p++;
+        if (play_subtask(g, &t, stop_flag)) return 1;
+        reorder_buckets(g);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Meet-in-the-middle: enumera todas as metades de cima válidas e guarda numa tabela hash
+// indexada pelas cores do lado sul da linha do meio, junto com o bitset das peças usadas.
+// Depois enumera as metades de baixo e procura a metade de cima com as mesmas cores no meio e
+// exatamente as peças que sobraram. As duas metades são preenchidas linha a linha.
+// A metade de cima é a guardada porque a quebra de simetria do canto (0,0) a deixa menor, e
+// a de baixo começa justamente pela linha do meio, onde a tabela já consegue podar:
+// - cada prefixo das cores do norte da linha do meio precisa existir em alguma metade de cima;
+// - com a linha do meio completa, as próximas linhas só podem usar peças que faltam em
+//   alguma metade de cima compatível (mascara allowed).
+// Na versão paralela cada trabalhador enumera uma fatia das metades de cima, as fatias são
+// juntadas com MPI_Allgatherv e cada um enumera sua fatia das metades de baixo contra a
+// tabela completa. As fatias são os ramos do nível split_depth, distribuídos em rodízio.
+// As duas enumerações são exaustivas, então em tabuleiros com muitas soluções a espiral acha a
+// primeira bem antes. Por isso uma estimativa de Knuth da metade de cima roda antes: se ela
+// prevê uma tabela maior que -b ou mais nós que MITM_NODE_BUDGET por trabalhador, o solver
+// desiste na hora, e a fatia de cada trabalhador para ao passar do orçamento de nós.
+// ---------------------------------------------------------------------------------------------
+
+#define MITM_NODE_BUDGET (1ULL << 20) // nós das duas fatias de um trabalhador antes da espiral
+#define MITM_PROBES 256                // amostras da estimativa da metade de cima
+
+typedef struct {
+  unsigned int half;           // linhas da metade de cima (as demais são da metade de baixo)
+  unsigned int words;          // palavras de 64 bits do bitset de peças
+  unsigned int cells;          // células da metade de cima
+  size_t entry_size;           // bytes por entrada: bitset, cores do meio e células (id * 4 + rotação)
+  unsigned char *entries;
+  unsigned long long *hashes;  // hash completo (cores + bitset) de cada entrada
+  unsigned int *next;          // encadeamento das entradas com as mesmas cores no meio
+  unsigned int *heads;         // primeiro elemento de cada bucket (MITM_EMPTY se vazio)
+  unsigned int count, capacity;
+  size_t limit;                // memória máxima das entradas, em bytes
+  unsigned long long bucket_mask;
+  unsigned long long *bloom;   // filtro com os prefixos das cores do meio
+  unsigned long long bloom_mask;
+  unsigned long long *bits;    // bitset de trabalho
+  unsigned long long *allowed; // peças permitidas abaixo da linha do meio
+  unsigned char *colors;       // cores do meio de trabalho
+  int share, nshares;          // fatia deste trabalhador e número de fatias
+  unsigned int split_depth;    // nível da busca em que os ramos são divididos entre os trabalhadores
+  unsigned long split_counter; // ramos já vistos no nível split_depth
+  int *stop_flag;
+  unsigned long long nodes;    // nós visitados, para o orçamento MITM_NODE_BUDGET
+} mitm_table;
+
+#define MITM_EMPTY 0xFFFFFFFFu
+
+unsigned long long mitm_mix(unsigned long long h, unsigned long long v) {
+  h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+  return splitmix64(&h);
+}
+
+// O hash das cores é o último prefixo do filtro; o hash completo continua sobre o bitset
+unsigned long long mitm_color_hash(const unsigned char *colors, unsigned int size) {
+  unsigned long long h = 0;
+  for (unsigned int i = 0; i < size; i++) h = mitm_mix(h, colors[i]);
+  return h;
+}
+
+unsigned long long mitm_full_hash(unsigned long long h, const unsigned long long *bits, unsigned int words) {
+  for (unsigned int i = 0; i < words; i++) h = mitm_mix(h, bits[i]);
+  return h;
+}
+
+void mitm_bloom_set(mitm_table *m, unsigned long long h) {
+  m->bloom[(h >> 6) & m->bloom_mask] |= 1ULL << (h & 63);
+}
+
+int mitm_bloom_test(mitm_table *m, unsigned long long h) {
+  return (m->bloom[(h >> 6) & m->bloom_mask] >> (h & 63)) & 1;
+}
+
+// Lê as cores do meio e o bitset das peças das linhas [y0, y1). Na folha da metade de baixo o
+// bitset é complementado, assim a busca na tabela é uma comparação exata com a metade de cima.
+void mitm_signature(mitm_table *m, game *g, int top, unsigned int y0, unsigned int y1, int complement) {
+  memset(m->bits, 0, m->words * sizeof(unsigned long long));
+  for (unsigned int j = y0; j < y1; j++)
+    for (unsigned int i = 0; i < g->size; i++) {
+      unsigned int id = g->board[j][i]->id;
+      m->bits[id / 64] |= 1ULL << (id % 64);
+    }
+  for (unsigned int i = 0; i < g->size; i++)
+    m->colors[i] = top ? S_COLOR(g->board[m->half - 1][i]) : N_COLOR(g->board[m->half][i]);
+  if (complement) {
+    for (unsigned int i = 0; i < m->words; i++) m->bits[i] = ~m->bits[i];
+    if (g->tile_count % 64) m->bits[m->words - 1] &= (1ULL << (g->tile_count % 64)) - 1;
+  }
+}
+
+// Folha da metade de cima: guarda a entrada. Retorna -1 se estourar o limite de memória.
+int mitm_store_top(game *g, mitm_table *m) {
+  if (m->count == m->capacity) {
+    unsigned int capacity = m->capacity ? m->capacity * 2 : 1024;
+    if ((size_t)capacity * m->entry_size > m->limit) {
+      capacity = (unsigned int)(m->limit / m->entry_size);
+      if (capacity <= m->count) return -1;
+    }
+    m->entries = realloc(m->entries, (size_t)capacity * m->entry_size);
+    m->hashes = realloc(m->hashes, (size_t)capacity * sizeof(unsigned long long));
+    assert(m->entries != NULL && m->hashes != NULL);
+    m->capacity = capacity;
+  }
+  mitm_signature(m, g, 1, 0, m->half, 0);
+  unsigned char *e = m->entries + (size_t)m->count * m->entry_size;
+  memcpy(e, m->bits, m->words * sizeof(unsigned long long));
+  e += m->words * sizeof(unsigned long long);
+  memcpy(e, m->colors, g->size);
+  unsigned short *cell = (unsigned short *)(e + g->size + (g->size & 1));
+  for (unsigned int j = 0; j < m->half; j++)
+    for (unsigned int i = 0; i < g->size; i++) {
+      tile *t = g->board[j][i];
+      *cell++ = (unsigned short)(t->id * 4 + t->rotation);
+    }
+  m->hashes[m->count] = mitm_full_hash(mitm_color_hash(m->colors, g->size), m->bits, m->words);
+  m->count++;
+  return 0;
+}
+
+// Linha do meio completa: calcula as peças que ainda podem ser usadas na metade de baixo.
+// Retorna 0 se nenhuma metade de cima com essas cores é disjunta da linha do meio.
+int mitm_middle_row(game *g, mitm_table *m, unsigned long long color_hash) {
+  int any = 0;
+  mitm_signature(m, g, 0, m->half, m->half + 1, 0);
+  memset(m->allowed, 0, m->words * sizeof(unsigned long long));
+  for (unsigned int k = m->heads[color_hash & m->bucket_mask]; k != MITM_EMPTY; k = m->next[k]) {
+    unsigned long long *top_bits = (unsigned long long *)(m->entries + (size_t)k * m->entry_size);
+    if (memcmp(top_bits + m->words, m->colors, g->size) != 0) continue;
+    int disjoint = 1;
+    for (unsigned int i = 0; i < m->words && disjoint; i++)
+      if (top_bits[i] & m->bits[i]) disjoint = 0;
+    if (!disjoint) continue;
+    for (unsigned int i = 0; i < m->words; i++) m->allowed[i] |= ~top_bits[i];
+    any = 1;
+  }
+  return any;
+}
+
+// Folha da metade de baixo: procura a metade de cima complementar e, se achar, completa o tabuleiro
+int mitm_probe_bottom(game *g, mitm_table *m) {
+  mitm_signature(m, g, 0, m->half, g->size, 1);
+  unsigned long long color_hash = mitm_color_hash(m->colors, g->size);
+  unsigned long long h = mitm_full_hash(color_hash, m->bits, m->words);
+  for (unsigned int k = m->heads[color_hash & m->bucket_mask]; k != MITM_EMPTY; k = m->next[k]) {
+    if (m->hashes[k] != h) continue;
+    unsigned char *e = m->entries + (size_t)k * m->entry_size;
+    if (memcmp(e, m->bits, m->words * sizeof(unsigned long long)) != 0) continue;
+    e += m->words * sizeof(unsigned long long);
+    if (memcmp(e, m->colors, g->size) != 0) continue;
+    unsigned short *cell = (unsigned short *)(e + g->size + (g->size & 1));
+    for (unsigned int j = 0; j < m->half; j++)
+      for (unsigned int i = 0; i < g->size; i++) {
+        tile *t = &g->tiles[*cell / 4];
+        t->rotation = *cell % 4;
+        g->board[j][i] = t;
+        cell++;
+      }
+    return 1;
+  }
+  return 0;
+}
+
+// Preenche as linhas [y, y_end) em varredura linha a linha e chama leaf em cada metade completa
+int mitm_fill(game *g, mitm_table *m, unsigned int x, unsigned int y, unsigned int y_end, int top,
+              unsigned long long prefix, int (*leaf)(game *, mitm_table *)) {
+  if (*m->stop_flag) return 0;
+  static int check_counter = 0;
+  if (!top && ++check_counter % 2000 == 0) {
+      int message_present = 0;
+      MPI_Iprobe(0, STOP, g->comm, &message_present, MPI_STATUS_IGNORE);
+      if (message_present) {
+          *m->stop_flag = 1;
+          return 0;
+      }
+  }
+  if (y == y_end) return leaf(g, m);
+  if (++m->nodes > MITM_NODE_BUDGET) return -2;
+
+  unsigned int depth = (y - (top ? 0 : m->half)) * g->size + x;
+  unsigned int required_color = (x > 0) ? E_COLOR(g->board[y][x - 1]) : 0;
+  tile_list *candidate_list = g->color_buckets[required_color];
+  unsigned int nx = (x + 1 < g->size) ? x + 1 : 0;
+  unsigned int ny = (nx == 0) ? y + 1 : y;
+
+  for (unsigned int i = 0; i < candidate_list->count; i++) {
+    tile *tile = candidate_list->tiles[i];
+    if (tile->used) continue;
+    // Quebra de simetria: a primeira peça de vértice sempre fica no canto (0,0), como em play_first
+    if (top && x == 0 && y == 0 && tile != g->tiles_vertice->tiles[0]) continue;
+    if (!top && y > m->half && !((m->allowed[tile->id / 64] >> (tile->id % 64)) & 1)) continue;
+
+    tile->used = 1;
+    for (int rot = 0; rot < 4; rot++) {
+      tile->rotation = rot;
+      if (!valid_move(g, x, y, tile)) continue;
+      if (depth == m->split_depth && m->split_counter++ % m->nshares != (unsigned long)m->share) continue;
+      unsigned long long next_prefix = prefix;
+      g->board[y][x] = tile;
+      if (!top && y == m->half) {
+        next_prefix = mitm_mix(prefix, N_COLOR(tile));
+        if (!mitm_bloom_test(m, next_prefix) || (nx == 0 && !mitm_middle_row(g, m, next_prefix))) {
+          g->board[y][x] = NULL;
+          continue;
+        }
+      }
+      int r = mitm_fill(g, m, nx, ny, y_end, top, next_prefix, leaf);
+      if (r != 0) {
+        tile->used = (r > 0);
+        if (r < 0) g->board[y][x] = NULL;
+        return r;
+      }
+      g->board[y][x] = NULL;
+    }
+    tile->used = 0;
+  }
+  return 0;
+}
+
+// Estimativa de Knuth da enumeração da metade de cima, na mesma ordem linha a linha de
+// mitm_fill. Retorna os nós previstos e guarda em leaves as metades completas previstas.
+double mitm_estimate(game *g, unsigned int half, double *leaves) {
+  unsigned long long seed = 0x5EED; // fixa: na versão MPI todos os trabalhadores decidem igual
+  unsigned int cells = half * g->size;
+  tile **path = malloc(cells * sizeof(tile*));
+  unsigned int *choices = malloc(g->tile_count * 4 * sizeof(unsigned int));
+  assert(path != NULL && choices != NULL);
+  double nodes = 0;
+  *leaves = 0;
+
+  for (unsigned int p = 0; p < MITM_PROBES; p++) {
+    double width = 1;
+    unsigned int d = 0;
+    nodes += 1;
+    while (d < cells) {
+      unsigned int x = d % g->size, y = d / g->size;
+      tile_list *candidate_list = g->color_buckets[x > 0 ? E_COLOR(g->board[y][x - 1]) : 0];
+      unsigned int n = 0;
+      for (unsigned int i = 0; i < candidate_list->count; i++) {
+        tile *t = candidate_list->tiles[i];
+        if (t->used || (d == 0 && t != g->tiles_vertice->tiles[0])) continue;
+        for (unsigned int rot = 0; rot < 4; rot++) {
+          t->rotation = rot;
+          if (valid_move(g, x, y, t)) choices[n++] = i * 4 + rot;
+        }
+      }
+      if (n == 0) break;
+      width *= n;
+      nodes += width;
+      unsigned int k = choices[splitmix64(&seed) % n];
+      tile *t = candidate_list->tiles[k / 4];
+      t->rotation = k % 4;
+      t->used = 1;
+      g->board[y][x] = t;
+      path[d++] = t;
+    }
+    if (d == cells) *leaves += width;
+    while (d > 0) {
+      d--;
+      path[d]->used = 0;
+      g->board[d / g->size][d % g->size] = NULL;
+    }
+  }
+
+  free(path);
+  free(choices);
+  *leaves /= MITM_PROBES;
+  return nodes / MITM_PROBES;
+}
+
+// Retorna 1 se este trabalhador achou solução, 0 se não achou, -1 se a tabela passou (ou
+// passaria, pela estimativa) de limit_mb megabytes e -2 se a metade de cima passou (ou
+// passaria) de MITM_NODE_BUDGET nós; esses testes são coletivos e todos recebem o mesmo código.
+// -3 indica que só a fatia deste trabalhador na metade de baixo passou do orçamento.
+int solve_mitm(game *g, unsigned int limit_mb, int share, MPI_Comm worker_comm, int *stop_flag) {
+  if (g->size < 2 || g->tiles_vertice->count == 0) return 0;
+
+  mitm_table m;
+  memset(&m, 0, sizeof(m));
+  m.half = g->size / 2;
+  m.words = (g->tile_count + 63) / 64;
+  m.cells = m.half * g->size;
+  m.entry_size = m.words * sizeof(unsigned long long) + g->size + (g->size & 1) + m.cells * sizeof(unsigned short);
+  m.entry_size = (m.entry_size + 7) & ~(size_t)7;
+  m.limit = (size_t)limit_mb << 20;
+  MPI_Comm_size(worker_comm, &m.nshares);
+
+  // A estimativa usa semente fixa, então todos os trabalhadores chegam à mesma decisão
+  double leaves, nodes = mitm_estimate(g, m.half, &leaves);
+  if (leaves * m.entry_size > m.limit) return -1;
+  if (nodes > (double)MITM_NODE_BUDGET * m.nshares) return -2;
+
+  m.bits = malloc(m.words * sizeof(unsigned long long));
+  m.allowed = malloc(m.words * sizeof(unsigned long long));
+  m.colors = malloc(g->size);
+  assert(m.bits != NULL && m.allowed != NULL && m.colors != NULL);
+  m.share = share;
+  m.stop_flag = stop_flag;
+
+  // Na metade de cima o canto (0,0) é fixo, então a divisão é feita na segunda célula
+  m.split_depth = 1;
+  int overflow = -mitm_fill(g, &m, 0, 0, m.half, 1, 0, mitm_store_top); // 1: memória, 2: nós
+
+  // Junta as fatias de todos os trabalhadores, se couberem no limite
+  int nshares = m.nshares;
+  int *counts = malloc(nshares * sizeof(int));
+  int *displs = malloc(nshares * sizeof(int));
+  int local_count = (int)m.count;
+  int any_overflow = 0;
+  MPI_Allreduce(&overflow, &any_overflow, 1, MPI_INT, MPI_MAX, worker_comm);
+  MPI_Allgather(&local_count, 1, MPI_INT, counts, 1, MPI_INT, worker_comm);
+  unsigned long long total = 0;
+  for (int i = 0; i < nshares; i++) total += counts[i];
+  if (total * m.entry_size > m.limit || total * m.entry_size > 0x7FFFFFFF) any_overflow = 1;
+
+  int result = -any_overflow;
+  if (!any_overflow) {
+    unsigned char *all_entries = malloc(total * m.entry_size + 1);
+    unsigned long long *all_hashes = malloc(total * sizeof(unsigned long long) + 1);
+    assert(all_entries != NULL && all_hashes != NULL);
+    int *byte_counts = malloc(nshares * sizeof(int));
+    for (int i = 0, offset = 0; i < nshares; i++) {
+      displs[i] = offset;
+      offset += counts[i];
+    }
+    MPI_Allgatherv(m.hashes, local_count, MPI_UNSIGNED_LONG_LONG, all_hashes, counts, displs,
+                   MPI_UNSIGNED_LONG_LONG, worker_comm);
+    for (int i = 0; i < nshares; i++) {
+      byte_counts[i] = counts[i] * (int)m.entry_size;
+      displs[i] *= (int)m.entry_size;
+    }
+    MPI_Allgatherv(m.entries, local_count * (int)m.entry_size, MPI_BYTE, all_entries, byte_counts, displs,
+                   MPI_BYTE, worker_comm);
+    free(byte_counts);
+    free(m.entries);
+    free(m.hashes);
+    m.entries = all_entries;
+    m.hashes = all_hashes;
+    m.count = (unsigned int)total;
+    result = 0;
+  }
+  free(counts);
+  free(displs);
+
+  if (result == 0 && m.count > 0) {
+    // Tabela hash com encadeamento e filtro de prefixos, ambos com potência de 2 posições
+    unsigned long long buckets = 1;
+    while (buckets < m.count) buckets *= 2;
+    m.bucket_mask = buckets - 1;
+    m.heads = malloc(buckets * sizeof(unsigned int));
+    m.next = malloc((size_t)m.count * sizeof(unsigned int));
+    unsigned long long bloom_words = 1;
+    while (bloom_words * 64 < (unsigned long long)m.count * g->size * 8) bloom_words *= 2;
+    m.bloom = calloc(bloom_words, sizeof(unsigned long long));
+    m.bloom_mask = bloom_words - 1;
+    assert(m.heads != NULL && m.next != NULL && m.bloom != NULL);
+    memset(m.heads, 0xFF, buckets * sizeof(unsigned int));
+
+    for (unsigned int k = 0; k < m.count; k++) {
+      unsigned char *colors = m.entries + (size_t)k * m.entry_size + m.words * sizeof(unsigned long long);
+      unsigned long long prefix = 0;
+      for (unsigned int i = 0; i < g->size; i++) {
+        prefix = mitm_mix(prefix, colors[i]);
+        mitm_bloom_set(&m, prefix);
+      }
+      m.next[k] = m.heads[prefix & m.bucket_mask];
+      m.heads[prefix & m.bucket_mask] = k;
+    }
+
+    m.split_depth = 0;
+    m.split_counter = 0;
+    result = mitm_fill(g, &m, 0, m.half, g->size, 0, 0, mitm_probe_bottom);
+    if (result == -2) result = -3;
+  }
+
+  free(m.entries);
+  free(m.hashes);
+  free(m.next);
+  free(m.heads);
+  free(m.bloom);
+  free(m.bits);
+  free(m.allowed);
+  free(m.colors);
+  return result;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Macro-peças 2x2 (-s macro): enumera todos os blocos 2x2 de peças distintas que casam por
+// dentro e busca num tabuleiro com metade do lado, linha a linha, um bloco por célula. Cada
+// classe de posição (quais lados do bloco são borda) tem o seu índice dos blocos válidos nela,
+// ordenado pela assinatura (cores do norte e do oeste), e os candidatos de cada célula saem de
+// uma busca binária nesse índice. As peças já usadas ficam num bitset. Só para lado par e sem
+// dicas; o bloco do canto (0,0) começa pela primeira peça de vértice, como play_first(g, 0).
+// Cada trabalhador enumera os blocos das suas peças NW e as fatias são juntadas com
+// MPI_Allgatherv; na busca os ramos da segunda célula são divididos entre os trabalhadores.
+// ---------------------------------------------------------------------------------------------
+
+// Cor do lado side da peça id na rotação rot, sem mexer na rotação guardada na peça
+#define ROT_COLOR(g, id, rot, side) ((g)->tiles[id].colors[((side) + 4 - (rot)) % 4])
+
+// Bloco 2x2 compacto: peças NW, NE, SW, SE e as 4 rotações, 2 bits cada (10 bytes)
+typedef struct {
+  unsigned short tile[4];
+  unsigned char rot;
+} macro_block;
+
+typedef struct {
+  unsigned long long key; // cores N e W do bloco (8 bits cada)
+  unsigned int block;
+} macro_entry;
+
+typedef struct {
+  macro_block *blocks;
+  unsigned int count, capacity;
+  size_t limit;                  // bytes permitidos para os blocos e os índices
+  macro_entry *entries[16];      // blocos válidos em cada classe (máscara dos lados de borda)
+  unsigned int entry_count[16];
+  unsigned int half;             // lado do tabuleiro de macro-peças
+  unsigned int words;
+  unsigned long long *used;      // bitset das peças usadas
+  unsigned int *choice;          // bloco escolhido em cada célula do tabuleiro de macro-peças
+  int share, nshares;            // fatia deste trabalhador e número de fatias
+  unsigned int split_depth;      // célula em que os ramos são divididos entre os trabalhadores
+  unsigned long split_counter;   // ramos já vistos em split_depth
+  int *stop_flag;
+} macro_table;
+
+// Cores do lado side do bloco (0 N, 1 E, 2 S, 3 W), de oeste para leste ou de norte para sul
+void macro_side(game *g, const macro_block *b, int side, unsigned int *c) {
+  static const int first[4] = {0, 1, 2, 0}, second[4] = {1, 3, 3, 2};
+  c[0] = ROT_COLOR(g, b->tile[first[side]], (b->rot >> (2 * first[side])) & 3, side);
+  c[1] = ROT_COLOR(g, b->tile[second[side]], (b->rot >> (2 * second[side])) & 3, side);
+}
+
+unsigned long long macro_key(const unsigned int *n, const unsigned int *w) {
+  return ((unsigned long long)n[0] << 24) | (n[1] << 16) | (w[0] << 8) | w[1];
+}
+
+// Lados de borda da célula (x, y) do tabuleiro de macro-peças: bit s para o lado s
+unsigned int macro_mask(unsigned int half, unsigned int x, unsigned int y) {
+  return (y == 0) | (x == half - 1) << 1 | (y == half - 1) << 2 | (x == 0) << 3;
+}
+
+int macro_push(macro_table *t, const unsigned int *id, const unsigned int *rot) {
+  if (t->count >= t->capacity) {
+    t->capacity = t->capacity ? t->capacity * 2 : 1024;
+    if ((size_t)t->capacity * sizeof(macro_block) > t->limit) return -1;
+    t->blocks = realloc(t->blocks, (size_t)t->capacity * sizeof(macro_block));
+    assert(t->blocks != NULL);
+  }
+  macro_block *b = &t->blocks[t->count++];
+  b->rot = 0;
+  for (int k = 0; k < 4; k++) {
+    b->tile[k] = (unsigned short)id[k];
+    b->rot |= rot[k] << (2 * k);
+  }
+  return 0;
+}
+
+// Enumera os blocos cuja peça NW é a peça a. Retorna -1 se a tabela passar do limite.
+int macro_enumerate(game *g, macro_table *t, unsigned int a) {
+  unsigned int id[4], rot[4];
+  id[0] = a;
+  for (rot[0] = 0; rot[0] < 4; rot[0]++) {
+    unsigned int east = ROT_COLOR(g, a, rot[0], 1), south = ROT_COLOR(g, a, rot[0], 2);
+    if (east >= g->ncolors || south >= g->ncolors) continue;
+    tile_list *ne = g->color_buckets[east], *sw = g->color_buckets[south];
+    for (unsigned int i = 0; i < ne->count; i++) {
+      id[1] = ne->tiles[i]->id;
+      if (id[1] == a) continue;
+      for (rot[1] = 0; rot[1] < 4; rot[1]++) {
+        if (ROT_COLOR(g, id[1], rot[1], 3) != east) continue;
+        unsigned int need_north = ROT_COLOR(g, id[1], rot[1], 2);
+        if (need_north >= g->ncolors) continue;
+        tile_list *se = g->color_buckets[need_north];
+        for (unsigned int j = 0; j < sw->count; j++) {
+          id[2] = sw->tiles[j]->id;
+          if (id[2] == a || id[2] == id[1]) continue;
+          for (rot[2] = 0; rot[2] < 4; rot[2]++) {
+            if (ROT_COLOR(g, id[2], rot[2], 0) != south) continue;
+            unsigned int need_west = ROT_COLOR(g, id[2], rot[2], 1);
+            for (unsigned int k = 0; k < se->count; k++) {
+              id[3] = se->tiles[k]->id;
+              if (id[3] == a || id[3] == id[1] || id[3] == id[2]) continue;
+              for (rot[3] = 0; rot[3] < 4; rot[3]++) {
+                if (ROT_COLOR(g, id[3], rot[3], 0) != need_north || ROT_COLOR(g, id[3], rot[3], 3) != need_west) continue;
+                if (macro_push(t, id, rot) < 0) return -1;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+int compare_macro_entries(const void *a, const void *b) {
+  const macro_entry *ea = a, *eb = b;
+  if (ea->key != eb->key) return ea->key < eb->key ? -1 : 1;
+  return (ea->block > eb->block) - (ea->block < eb->block);
+}
+
+// Monta o índice de cada classe de posição que aparece no tabuleiro. Retorna -1 se passar
+// do limite de memória.
+int macro_index(game *g, macro_table *t) {
+  size_t bytes = (size_t)t->count * sizeof(macro_block);
+  for (unsigned int mask = 0; mask < 16; mask++) {
+    int present = 0;
+    for (unsigned int c = 0; c < t->half * t->half && !present; c++)
+      present = macro_mask(t->half, c % t->half, c / t->half) == mask;
+    if (!present) continue;
+    // A classe do canto (0,0) só existe nessa célula: ali fica a quebra de simetria
+    int corner = (mask == macro_mask(t->half, 0, 0));
+
+    unsigned int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      n = 0;
+      for (unsigned int i = 0; i < t->count; i++) {
+        const macro_block *b = &t->blocks[i];
+        int ok = !corner || b->tile[0] == g->tiles_vertice->tiles[0]->id;
+        for (int s = 0; s < 4 && ok; s++) {
+          if (!(mask >> s & 1)) continue;
+          unsigned int c[2];
+          macro_side(g, b, s, c);
+          ok = c[0] == 0 && c[1] == 0;
+        }
+        if (!ok) continue;
+        if (pass == 1) {
+          unsigned int nc[2], wc[2];
+          macro_side(g, b, 0, nc);
+          macro_side(g, b, 3, wc);
+          t->entries[mask][n].key = macro_key(nc, wc);
+          t->entries[mask][n].block = i;
+        }
+        n++;
+      }
+      if (pass == 0) {
+        bytes += (size_t)n * sizeof(macro_entry);
+        if (bytes > t->limit) return -1;
+        t->entries[mask] = malloc((size_t)n * sizeof(macro_entry) + 1);
+        assert(t->entries[mask] != NULL);
+      }
+    }
+    t->entry_count[mask] = n;
+    qsort(t->entries[mask], n, sizeof(macro_entry), compare_macro_entries);
+  }
+  return 0;
+}
+
+// Busca linha a linha no tabuleiro de macro-peças
+int macro_search(game *g, macro_table *t, unsigned int cell) {
+  unsigned int half = t->half;
+  if (*t->stop_flag) return 0;
+  if (cell == half * half) return 1;
+  static int check_counter = 0;
+  if (++check_counter % 2000 == 0) {
+      int message_present = 0;
+      MPI_Iprobe(0, STOP, g->comm, &message_present, MPI_STATUS_IGNORE);
+      if (message_present) {
+          *t->stop_flag = 1;
+          return 0;
+      }
+  }
+  unsigned int x = cell % half, y = cell / half;
+  unsigned int north[2] = {0, 0}, west[2] = {0, 0};
+  if (y > 0) macro_side(g, &t->blocks[t->choice[cell - half]], 2, north);
+  if (x > 0) macro_side(g, &t->blocks[t->choice[cell - 1]], 1, west);
+  unsigned long long key = macro_key(north, west);
+
+  unsigned int mask = macro_mask(half, x, y);
+  const macro_entry *e = t->entries[mask];
+  unsigned int lo = 0, hi = t->entry_count[mask];
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (e[mid].key < key) lo = mid + 1;
+    else hi = mid;
+  }
+
+  for (unsigned int k = lo; k < t->entry_count[mask] && e[k].key == key && !*t->stop_flag; k++) {
+    const macro_block *b = &t->blocks[e[k].block];
+    int free_tiles = 1;
+    for (int p = 0; p < 4 && free_tiles; p++)
+      free_tiles = !(t->used[b->tile[p] / 64] >> (b->tile[p] % 64) & 1);
+    if (!free_tiles) continue;
+    if (cell == t->split_depth && t->split_counter++ % t->nshares != (unsigned long)t->share) continue;
+    for (int p = 0; p < 4; p++) t->used[b->tile[p] / 64] |= 1ULL << (b->tile[p] % 64);
+    t->choice[cell] = e[k].block;
+    if (macro_search(g, t, cell + 1)) return 1;
+    for (int p = 0; p < 4; p++) t->used[b->tile[p] / 64] &= ~(1ULL << (b->tile[p] % 64));
+  }
+  return 0;
+}
+
+// Copia a solução do tabuleiro de macro-peças para o tabuleiro do jogo
+void macro_apply(game *g, const macro_table *t) {
+  for (unsigned int cell = 0; cell < t->half * t->half; cell++) {
+    const macro_block *b = &t->blocks[t->choice[cell]];
+    for (int p = 0; p < 4; p++) {
+      tile *tl = &g->tiles[b->tile[p]];
+      tl->rotation = (b->rot >> (2 * p)) & 3;
+      tl->used = 1;
+      g->board[2 * (cell / t->half) + p / 2][2 * (cell % t->half) + p % 2] = tl;
+    }
+  }
+}
+
+void free_macro(macro_table *t) {
+  free(t->blocks);
+  for (int mask = 0; mask < 16; mask++) free(t->entries[mask]);
+  free(t->used);
+  free(t->choice);
+}
+
+// Retorna 1 se este trabalhador achou solução, 0 se não achou e -1 se a tabela passou de
+// limit_mb megabytes (todos recebem o mesmo -1, pois o teste é coletivo).
+int solve_macro(game *g, unsigned int limit_mb, int share, MPI_Comm worker_comm, int *stop_flag) {
+  if (g->size < 2 || g->tiles_vertice->count == 0) return 0;
+
+  macro_table t;
+  memset(&t, 0, sizeof(t));
+  t.half = g->size / 2;
+  t.limit = (size_t)limit_mb << 20;
+  t.share = share;
+  MPI_Comm_size(worker_comm, &t.nshares);
+  t.stop_flag = stop_flag;
+  int overflow = 0;
+  for (unsigned int a = share; a < g->tile_count && !overflow; a += t.nshares) overflow = (macro_enumerate(g, &t, a) < 0);
+
+  // Junta as fatias de todos os trabalhadores, se couberem no limite
+  int nshares = t.nshares;
+  int *counts = malloc(nshares * sizeof(int));
+  int *displs = malloc(nshares * sizeof(int));
+  int local_count = (int)t.count;
+  int any_overflow = 0;
+  MPI_Allreduce(&overflow, &any_overflow, 1, MPI_INT, MPI_MAX, worker_comm);
+  MPI_Allgather(&local_count, 1, MPI_INT, counts, 1, MPI_INT, worker_comm);
+  unsigned long long total = 0;
+  for (int i = 0; i < nshares; i++) total += counts[i];
+  if (total * sizeof(macro_block) > t.limit || total * sizeof(macro_block) > 0x7FFFFFFF) any_overflow = 1;
+
+  int result = -1;
+  if (!any_overflow) {
+    macro_block *all_blocks = malloc(total * sizeof(macro_block) + 1);
+    assert(all_blocks != NULL);
+    for (int i = 0, offset = 0; i < nshares; i++) {
+      displs[i] = offset * (int)sizeof(macro_block);
+      offset += counts[i];
+      counts[i] *= (int)sizeof(macro_block);
+    }
+    MPI_Allgatherv(t.blocks, local_count * (int)sizeof(macro_block), MPI_BYTE, all_blocks, counts, displs,
+                   MPI_BYTE, worker_comm);
+    free(t.blocks);
+    t.blocks = all_blocks;
+    t.count = (unsigned int)total;
+    // O índice é montado igual em todos, então o teste de memória dele não precisa ser coletivo
+    result = macro_index(g, &t);
+  }
+  free(counts);
+  free(displs);
+
+  if (result == 0) {
+    if (share == 0)
+      fprintf(stderr, "Macro-peças: %u blocos 2x2 (%.1f MB)\n", t.count, (double)t.count * sizeof(macro_block) / (1 << 20));
+    t.words = (g->tile_count + 63) / 64;
+    t.used = calloc(t.words, sizeof(unsigned long long));
+    t.choice = malloc(t.half * t.half * sizeof(unsigned int));
+    assert(t.used != NULL && t.choice != NULL);
+    t.split_depth = t.half > 1 ? 1 : 0;
+    result = macro_search(g, &t, 0);
+    if (result) macro_apply(g, &t);
+  }
+
+  free_macro(&t);
+  return result;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Modo servidor (-d caminho): o programa fica de pé com os trabalhadores já inicializados e
+// recebe tabuleiros por um socket Unix local, sem pagar de novo o lançamento, o MPI_Init e a
+// preparação de cada processo. Cada conexão manda um tabuleiro no formato da entrada padrão e
+// termina com uma linha "fim"; a resposta é a mesma saída do modo normal mais uma linha de
+// estatísticas do pedido, e a conexão é fechada. O "fim" pode vir sem quebra de linha se o
+// cliente fechar a escrita logo depois (shutdown); fechar a conexão inteira ou mandar qualquer
+// coisa depois do "fim" cancela o pedido, esteja ele na fila ou em execução. Os pedidos "estado" e
+// "sair" (também seguidos de "fim") mostram a fila e encerram o servidor depois dela.
+// O P0 só atende os sockets. Os demais processos formam -g grupos de ranks consecutivos, cada
+// um com o seu comunicador: o primeiro rank do grupo é o líder, que faz o papel do P0 do modo
+// normal, e os outros são os trabalhadores. Cada grupo resolve um pedido por vez e grupos
+// diferentes resolvem pedidos diferentes ao mesmo tempo; um grupo livre pega o próximo pedido
+// da fila na ordem escolhida por -q. Entre um pedido e outro cada processo guarda o jogo do
+// último tabuleiro (game_shell) e a tabela de nogoods do grupo.
+// ---------------------------------------------------------------------------------------------
+
+#define DAEMON_MAX_CLIENTS 64        // conexões abertas ao mesmo tempo
+#define DAEMON_MAX_REQUEST (16 << 20) // bytes de um pedido
+
+// Políticas da fila (opção -q)
+#define QUEUE_FIFO 0  // ordem de chegada
+#define QUEUE_SMALL 1 // tabuleiros com menos peças primeiro, empate pela chegada
+
+typedef struct {
+  int fd;                 // -1 se a posição está livre
+  char *text;             // pedido lido até agora
+  size_t length, capacity;
+  int ready;              // pedido completo, esperando na fila ou em execução
+  int eof;                // o cliente fechou o lado de escrita (shutdown, como nc -N ou socat)
+  int cancelled;
+  int group;              // grupo que está resolvendo o pedido (-1 se ainda não saiu da fila)
+  unsigned int id;        // número do pedido, na ordem de chegada
+  unsigned long long tiles;
+  double arrival, start;  // chegada do pedido e saída da fila
+} daemon_client;
+
+typedef struct {
+  int listen_fd;          // -1 depois de "sair"
+  const char *path;
+  int policy;             // QUEUE_*
+  daemon_client clients[DAEMON_MAX_CLIENTS];
+  int groups;
+  int *leaders;           // rank do líder de cada grupo
+  int *running;           // cliente em execução em cada grupo (-1 se o grupo está livre)
+  unsigned int next_id, served, cancelled;
+} daemon_state;
+
+// Grupo do processo rank (de 1 a mpi_size - 1) quando os trabalhadores são divididos em groups
+int daemon_group(int rank, int mpi_size, int groups) {
+  return (rank - 1) * groups / (mpi_size - 1);
+}
+
+// Fecha a conexão e libera a posição
+void daemon_drop(daemon_state *s, int c) {
+  daemon_client *cl = &s->clients[c];
+  close(cl->fd);
+  free(cl->text);
+  memset(cl, 0, sizeof(*cl));
+  cl->fd = -1;
+  cl->group = -1;
+}
+
+// Manda a resposta inteira e fecha; se o cliente já foi embora a resposta é descartada
+void daemon_reply(daemon_state *s, int c, const char *text, size_t length) {
+  while (length > 0) {
+    ssize_t n = send(s->clients[c].fd, text, length, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    text += n;
+    length -= (size_t)n;
+  }
+  daemon_drop(s, c);
+}
+
+void daemon_reply_text(daemon_state *s, int c, const char *text) {
+  daemon_reply(s, c, text, strlen(text));
+}
+
+// Confere um tabuleiro antes de ele chegar em initialize, que aborta com assert. Retorna NULL
+// se está tudo certo ou a descrição do problema.
+const char *request_error(const char *text) {
+  if (text[0] == '\0') return "pedido vazio";
+  FILE *input = fmemopen((void *)text, strlen(text), "r");
+  if (input == NULL) return "sem memória";
+  const char *error = NULL;
+  unsigned int bsize, ncolors, nclues = 0;
+  unsigned int *colors = NULL, *at = NULL;
+  if (fscanf(input, "%u %u", &bsize, &ncolors) != 2) error = "cabeçalho sem lado e número de cores";
+  else if (bsize == 0 || bsize > MAX_BOARD_SIZE) error = "lado do tabuleiro fora de 1..128";
+  else if (ncolors >= 256) error = "mais de 255 cores";
+  if (error == NULL) {
+    colors = malloc((size_t)bsize * bsize * 4 * sizeof(unsigned int));
+    at = malloc((size_t)bsize * bsize * sizeof(unsigned int));
+    assert(colors != NULL && at != NULL);
+    for (unsigned int i = 0; i < bsize * bsize * 4 && error == NULL; i++)
+      if (fscanf(input, "%u", &colors[i]) != 1) error = "faltam peças";
+      else if (colors[i] > ncolors) error = "cor maior que o número de cores";
+  }
+  // Mesmas regras de place_clues: posição livre, peça ainda não usada e casando com a borda e
+  // com as dicas vizinhas
+  if (error == NULL && fscanf(input, "%u", &nclues) == 1) {
+    if (nclues > bsize * bsize) error = "mais dicas que células";
+    for (unsigned int i = 0; i < bsize * bsize; i++) at[i] = 0xFFFFFFFFu;
+    for (unsigned int i = 0; i < nclues && error == NULL; i++) {
+      unsigned int x, y, id, rot;
+      if (fscanf(input, "%u %u %u %u", &x, &y, &id, &rot) != 4) error = "dica incompleta";
+      else if (x >= bsize || y >= bsize || id >= bsize * bsize || rot >= 4) error = "dica fora do tabuleiro";
+      else if (at[y * bsize + x] != 0xFFFFFFFFu) error = "duas dicas na mesma célula";
+      else {
+        for (unsigned int k = 0; k < bsize * bsize && error == NULL; k++)
+          if (at[k] != 0xFFFFFFFFu && at[k] / 4 == id) error = "peça usada em duas dicas";
+        at[y * bsize + x] = id * 4 + rot;
+      }
+    }
+    static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+    for (unsigned int k = 0; k < bsize * bsize && error == NULL; k++) {
+      if (at[k] == 0xFFFFFFFFu) continue;
+      unsigned int x = k % bsize, y = k / bsize;
+      for (int s = 0; s < 4 && error == NULL; s++) {
+        unsigned int color = colors[(at[k] / 4) * 4 + (s + 4 - at[k] % 4) % 4];
+        int nx = (int)x + dx[s], ny = (int)y + dy[s];
+        if (nx < 0 || ny < 0 || nx >= (int)bsize || ny >= (int)bsize) {
+          if (color != 0) error = "dica sem cor 0 na borda";
+          continue;
+        }
+        unsigned int other = at[ny * bsize + nx];
+        if (other == 0xFFFFFFFFu) continue;
+        if (colors[(other / 4) * 4 + ((s + 2) % 4 + 4 - other % 4) % 4] != color) error = "dicas vizinhas não casam";
+      }
+    }
+  }
+  free(colors);
+  free(at);
+  fclose(input);
+  return error;
+}
+
+void daemon_status(daemon_state *s, int c) {
+  size_t capacity = 128 + 96 * (size_t)s->groups;
+  char *text = malloc(capacity);
+  int queued = 0, n = 0;
+  assert(text != NULL);
+  for (int i = 0; i < DAEMON_MAX_CLIENTS; i++)
+    if (s->clients[i].fd >= 0 && s->clients[i].ready && !s->clients[i].cancelled && s->clients[i].group < 0) queued++;
+  n += snprintf(text + n, capacity - n, "Pedidos atendidos: %u, cancelados: %u, na fila: %d\n",
+                s->served, s->cancelled, queued);
+  for (int k = 0; k < s->groups; k++) {
+    if (s->running[k] < 0) {
+      n += snprintf(text + n, capacity - n, "Grupo %d: livre\n", k);
+      continue;
+    }
+    const daemon_client *cl = &s->clients[s->running[k]];
+    n += snprintf(text + n, capacity - n, "Grupo %d: pedido %u (%llu peças, %.3f s)\n", k, cl->id, cl->tiles,
+                  MPI_Wtime() - cl->start);
+  }
+  daemon_reply(s, c, text, (size_t)n);
+  free(text);
+}
+
+// O pedido do cliente c acabou de chegar inteiro
+void daemon_request(daemon_state *s, int c) {
+  daemon_client *cl = &s->clients[c];
+  if (strncmp(cl->text, "estado", 6) == 0) {
+    daemon_status(s, c);
+  } else if (strncmp(cl->text, "sair", 4) == 0) {
+    // Para de aceitar conexões; os pedidos já na fila ainda são resolvidos
+    if (s->listen_fd >= 0) {
+      close(s->listen_fd);
+      unlink(s->path);
+      s->listen_fd = -1;
+    }
+    daemon_reply_text(s, c, "Encerrando depois da fila\n");
+  } else {
+    const char *error = request_error(cl->text);
+    if (error != NULL) {
+      char text[256];
+      snprintf(text, sizeof(text), "Pedido inválido: %s\n", error);
+      daemon_reply_text(s, c, text);
+      return;
+    }
+    unsigned int bsize = 0;
+    sscanf(cl->text, "%u", &bsize);
+    cl->ready = 1;
+    cl->id = s->next_id++;
+    cl->tiles = (unsigned long long)bsize * bsize;
+    cl->arrival = MPI_Wtime();
+  }
+}
+
+// Procura a linha "fim" que encerra o pedido. No fim da entrada ela pode vir sem a quebra de
+// linha. Retorna NULL se ela ainda não chegou.
+char *request_end(char *text, int at_eof) {
+  for (char *end = text; (end = strstr(end, "fim")) != NULL; end++) {
+    if (end != text && end[-1] != '\n') continue;
+    if (end[3] == '\n' || end[3] == '\r' || (at_eof && end[3] == '\0')) return end;
+  }
+  return NULL;
+}
+
+void daemon_cancel(daemon_state *s, int c) {
+  daemon_client *cl = &s->clients[c];
+  cl->cancelled = 1;
+  s->cancelled++;
+  // Um pedido cancelado em execução só é fechado quando a resposta do grupo chegar
+  if (cl->group < 0) daemon_drop(s, c);
+  else MPI_Send(&c, 1, MPI_INT, s->leaders[cl->group], CANCEL, MPI_COMM_WORLD);
+}
+
+// Atende o socket de escuta e as conexões por até timeout_ms milissegundos (-1 espera).
+// Depois do "fim", fechar só o lado de escrita é o fim normal da entrada; fechar a conexão
+// inteira (POLLHUP) ou mandar mais dados cancela o pedido.
+void daemon_poll(daemon_state *s, int timeout_ms) {
+  struct pollfd fds[DAEMON_MAX_CLIENTS + 1];
+  int owner[DAEMON_MAX_CLIENTS + 1], n = 0, open_clients = 0;
+  for (int c = 0; c < DAEMON_MAX_CLIENTS; c++) {
+    if (s->clients[c].fd < 0) continue;
+    open_clients++;
+    if (s->clients[c].cancelled) continue;
+    fds[n].fd = s->clients[c].fd;
+    // Depois do EOF só interessa o POLLHUP, que o poll sempre informa
+    fds[n].events = s->clients[c].eof ? 0 : POLLIN;
+    owner[n++] = c;
+  }
+  if (s->listen_fd >= 0 && open_clients < DAEMON_MAX_CLIENTS) {
+    fds[n].fd = s->listen_fd;
+    fds[n].events = POLLIN;
+    owner[n++] = -1;
+  }
+  if (poll(fds, n, timeout_ms) <= 0) return;
+
+  for (int i = 0; i < n; i++) {
+    if (!fds[i].revents) continue;
+    if (owner[i] < 0) {
+      int fd = accept(s->listen_fd, NULL, NULL);
+      if (fd < 0) continue;
+      for (int c = 0; c < DAEMON_MAX_CLIENTS; c++) {
+        if (s->clients[c].fd >= 0) continue;
+        s->clients[c].fd = fd;
+        fd = -1;
+        break;
+      }
+      if (fd >= 0) close(fd);
+      continue;
+    }
+
+    int c = owner[i];
+    daemon_client *cl = &s->clients[c];
+    if (cl->ready && (fds[i].revents & (POLLHUP | POLLERR))) {
+      daemon_cancel(s, c);
+      continue;
+    }
+    if (cl->eof) continue;
+    char buffer[65536];
+    ssize_t got = read(cl->fd, buffer, sizeof(buffer));
+    if (got < 0 && errno == EINTR) continue;
+    if (cl->ready) {
+      if (got == 0) cl->eof = 1;
+      else daemon_cancel(s, c);
+      continue;
+    }
+    if (got < 0 || cl->length + got > DAEMON_MAX_REQUEST) {
+      daemon_drop(s, c);
+      continue;
+    }
+    if (got == 0) {
+      cl->eof = 1;
+    } else {
+      if (cl->length + got + 1 > cl->capacity) {
+        cl->capacity = (cl->length + got + 1) * 2;
+        cl->text = realloc(cl->text, cl->capacity);
+        assert(cl->text != NULL);
+      }
+      memcpy(cl->text + cl->length, buffer, got);
+      cl->length += got;
+      cl->text[cl->length] = '\0';
+    }
+
+    char *end = cl->text ? request_end(cl->text, cl->eof) : NULL;
+    if (end == NULL) {
+      // Fechou sem mandar o "fim": não há pedido
+      if (cl->eof) daemon_drop(s, c);
+      continue;
+    }
+    // O que vier junto depois do "fim" já é um cancelamento
+    char *rest = end + 3;
+    while (*rest == '\r' || *rest == '\n') rest++;
+    *end = '\0';
+    cl->length = end - cl->text;
+    daemon_request(s, c);
+    if (*rest != '\0' && s->clients[c].fd >= 0 && s->clients[c].ready) daemon_cancel(s, c);
+  }
+}
+
+// Próximo pedido da fila segundo a política, ou -1 se a fila está vazia
+int daemon_next(daemon_state *s) {
+  int best = -1;
+  for (int c = 0; c < DAEMON_MAX_CLIENTS; c++) {
+    const daemon_client *cl = &s->clients[c];
+    if (cl->fd < 0 || !cl->ready || cl->cancelled || cl->group >= 0) continue;
+    if (best < 0) best = c;
+    else if (s->policy == QUEUE_SMALL && cl->tiles != s->clients[best].tiles) {
+      if (cl->tiles < s->clients[best].tiles) best = c;
+    } else if (cl->id < s->clients[best].id) best = c;
+  }
+  return best;
+}
+
+// Manda o pedido do cliente c para o líder do grupo k, que está livre e esperando
+void daemon_start(daemon_state *s, int c, int k) {
+  daemon_client *cl = &s->clients[c];
+  cl->group = k;
+  cl->start = MPI_Wtime();
+  s->running[k] = c;
+  MPI_Send(cl->text, (int)cl->length, MPI_CHAR, s->leaders[k], REQUEST, MPI_COMM_WORLD);
+}
+
+// Recebe a resposta que o líder em status mandou e a repassa ao cliente, com a linha de
+// estatísticas do pedido. A resposta de um pedido cancelado é descartada.
+void daemon_finish(daemon_state *s, const MPI_Status *status) {
+  int length, k = 0;
+  MPI_Get_count(status, MPI_CHAR, &length);
+  char *reply = malloc((size_t)length + 256);
+  assert(reply != NULL);
+  MPI_Recv(reply, length, MPI_CHAR, status->MPI_SOURCE, REPLY, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  while (s->leaders[k] != status->MPI_SOURCE) k++;
+  int c = s->running[k];
+  daemon_client *cl = &s->clients[c];
+  s->running[k] = -1;
+  if (cl->cancelled) {
+    daemon_drop(s, c);
+  } else {
+    length += snprintf(reply + length, 256, "Pedido %u: %llu peças, %.3f s na fila, grupo %d\n", cl->id, cl->tiles,
+                       cl->start - cl->arrival, k);
+    s->served++;
+    daemon_reply(s, c, reply, (size_t)length);
+  }
+  free(reply);
+}
+
+// Laço do P0 no modo servidor: os grupos livres recebem os próximos pedidos da fila e os sockets
+// são atendidos enquanto os grupos trabalham. Depois de "sair", quando a fila e os grupos se
+// esvaziam, os líderes recebem STOP.
+void daemon_serve(daemon_state *s) {
+  while (1) {
+    int busy = 0;
+    for (int k = 0; k < s->groups; k++) {
+      int c = s->running[k] < 0 ? daemon_next(s) : -1;
+      if (c >= 0) daemon_start(s, c, k);
+      if (s->running[k] >= 0) busy++;
+    }
+    // Sem grupo ocupado a fila está vazia
+    if (!busy && s->listen_fd < 0) break;
+    int message_present = 0;
+    MPI_Status status;
+    if (busy) MPI_Iprobe(MPI_ANY_SOURCE, REPLY, MPI_COMM_WORLD, &message_present, &status);
+    if (message_present) daemon_finish(s, &status);
+    else daemon_poll(s, busy ? 1 : -1);
+  }
+  for (int k = 0; k < s->groups; k++) MPI_Send(&k, 1, MPI_INT, s->leaders[k], STOP, MPI_COMM_WORLD);
+}
+
+// Abre o socket de escuta. Um socket velho no mesmo caminho é trocado; qualquer outro arquivo
+// lá é um erro.
+int daemon_open(daemon_state *s, const char *path, int policy, int groups, int mpi_size) {
+  struct sockaddr_un address;
+  struct stat info;
+  memset(s, 0, sizeof(*s));
+  for (int c = 0; c < DAEMON_MAX_CLIENTS; c++) {
+    s->clients[c].fd = -1;
+    s->clients[c].group = -1;
+  }
+  s->path = path;
+  s->policy = policy;
+  s->next_id = 1;
+  s->groups = groups;
+  s->leaders = malloc(groups * sizeof(int));
+  s->running = malloc(groups * sizeof(int));
+  assert(s->leaders != NULL && s->running != NULL);
+  for (int k = 0; k < groups; k++) s->running[k] = -1;
+  for (int rank = mpi_size - 1; rank >= 1; rank--) s->leaders[daemon_group(rank, mpi_size, groups)] = rank;
+  if (strlen(path) >= sizeof(address.sun_path)) return -1;
+  if (stat(path, &info) == 0) {
+    if (!S_ISSOCK(info.st_mode)) return -1;
+    unlink(path);
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+  s->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (s->listen_fd < 0) return -1;
+  if (bind(s->listen_fd, (struct sockaddr *)&address, sizeof(address)) < 0 || listen(s->listen_fd, DAEMON_MAX_CLIENTS) < 0) {
+    close(s->listen_fd);
+    return -1;
+  }
+  return 0;
+}
+
+void daemon_close(daemon_state *s) {
+  for (int c = 0; c < DAEMON_MAX_CLIENTS; c++)
+    if (s->clients[c].fd >= 0) daemon_drop(s, c);
+  if (s->listen_fd >= 0) {
+    close(s->listen_fd);
+    unlink(s->path);
+  }
+  free(s->leaders);
+  free(s->running);
+}
+
+// Lógica do P0: Enviar dados para os outros processadores e gerenciar a execução
+// O P0 e os trabalhadores são os processos de g->comm e o resultado vai para out. No modo
+// servidor (serving) quem faz o papel do P0 é o líder do grupo, que também aceita um CANCEL do
+// P0 de MPI_COMM_WORLD e para os trabalhadores como se uma solução tivesse sido achada.
+// Retorna quantas unidades foram distribuídas.
+int master_process(game *g, int mpi_size, int solver, unsigned int probes, int count_all, int first_choice,
+                   FILE *out, int serving) {
+    double start_time, end_time;
+    int next_task = 0, workers_finished = 0, solution_found = 0, cancelled = 0;
+    int tot_tasks, **units, *lengths;
+    unsigned long long solutions = 0;
+
+    // No MITM e nas macro-peças cada trabalhador recebe a sua fatia; na espiral as unidades
+    // vêm do planejamento
+    if (solver == SOLVER_MITM || solver == SOLVER_MACRO) {
+        tot_tasks = mpi_size - 1;
+        units = malloc(tot_tasks * sizeof(int *));
+        lengths = malloc(tot_tasks * sizeof(int));
+        for (int i = 0; i < tot_tasks; i++) {
+            units[i] = malloc(3 * sizeof(int));
+            units[i][0] = 1; units[i][1] = i; units[i][2] = 0;
+            lengths[i] = 3;
+        }
+    } else if (solver == SOLVER_DLX) {
+        // Cada ramo do nível de divisão é uma unidade [1, ramo, nível]
+        int stop_flag = 0;
+        dlx *d = build_dlx(g, count_all);
+        d->stop_flag = &stop_flag;
+        tot_tasks = (int)dlx_plan(d, g, (unsigned int)(mpi_size - 1) * SPLIT_FACTOR);
+        units = malloc((tot_tasks + 1) * sizeof(int *));
+        lengths = malloc((tot_tasks + 1) * sizeof(int));
+        for (int i = 0; i < tot_tasks; i++) {
+            units[i] = malloc(3 * sizeof(int));
+            units[i][0] = 1; units[i][1] = i; units[i][2] = (int)d->split_depth;
+            lengths[i] = 3;
+        }
+        free_dlx(d);
+    } else {
+        tot_tasks = plan_units(g, mpi_size - 1, probes, &units, &lengths);
+        // No modo automático as unidades da tarefa vencedora das sondas saem primeiro
+        for (int i = 0, front = 0; first_choice >= 0 && i < tot_tasks; i++) {
+            if (units[i][1] != first_choice) continue;
+            int *unit = units[i], length = lengths[i];
+            memmove(&units[front + 1], &units[front], (i - front) * sizeof(int *));
+            memmove(&lengths[front + 1], &lengths[front], (i - front) * sizeof(int));
+            units[front] = unit;
+            lengths[front] = length;
+            front++;
+        }
+    }
+    
+    MPI_Barrier(g->comm);
+    start_time = MPI_Wtime();
+
+    // Distribui as tarefas iniciais para os trabalhadores e gerenciar quando uma resposta é encontrada
+    for (int rank = 1; rank < mpi_size; rank++) {
+        if (next_task < tot_tasks) {
+            MPI_Send(units[next_task], lengths[next_task], MPI_INT, rank, WORK, g->comm);
+            next_task++;
+        } else {
+            MPI_Send(&next_task, 1, MPI_INT, rank, STOP, g->comm); // Nenhuma tarefa para este
+            workers_finished++;
+        }
+    }
+
+    while (workers_finished < (mpi_size - 1)) {
+        
+        // A função Probe foi uma sugestão do GPT de como passar mensagens de modo não bloqueante através de Tags
+        MPI_Status status;
+        if (!serving) {
+            MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, g->comm, &status);
+        } else {
+            int message_present = 0;
+            while (!message_present) {
+                MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, g->comm, &message_present, &status);
+                if (message_present) break;
+                int cancel_present = 0;
+                MPI_Iprobe(0, CANCEL, MPI_COMM_WORLD, &cancel_present, MPI_STATUS_IGNORE);
+                if (!cancel_present) {
+                    usleep(1000);
+                    continue;
+                }
+                MPI_Recv(&cancel_present, 1, MPI_INT, 0, CANCEL, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                if (!cancelled && !solution_found) {
+                    cancelled = 1;
+                    for (int rank = 1; rank < mpi_size; rank++)
+                        MPI_Send(&next_task, 1, MPI_INT, rank, STOP, g->comm);
+                }
+            }
+        }
+        
+        if (status.MPI_TAG == FOUND) {
+            int num_tiles = g->size * g->size;
+            solution_tile* final_solution = malloc(num_tiles * sizeof(solution_tile));
+            MPI_Recv(final_solution, num_tiles * sizeof(solution_tile), MPI_BYTE, status.MPI_SOURCE, FOUND, g->comm, MPI_STATUS_IGNORE);
+            
+            if (!solution_found && !cancelled) {
+                solution_found = 1;
+                end_time = MPI_Wtime();
+                //printf("SOLUÇÃO ENCONTRADA (pelo trabalhador %d):\n", status.MPI_SOURCE);
+                print_solution(out, final_solution, g->size);
+                //printf("\nTempo de execução: %f segundos\n", end_time - start_time);
+                
+                // Manda parar todos os trabalhadores
+                for (int rank = 1; rank < mpi_size; rank++) {
+                    MPI_Send(&next_task, 1, MPI_INT, rank, STOP, g->comm);
+                }
+            }
+            free(final_solution);
+            workers_finished++;
+
+        } else if (status.MPI_TAG == FAIL || status.MPI_TAG == COUNT) {
+            if (status.MPI_TAG == COUNT) {
+                unsigned long long count;
+                MPI_Recv(&count, 1, MPI_UNSIGNED_LONG_LONG, status.MPI_SOURCE, COUNT, g->comm, MPI_STATUS_IGNORE);
+                solutions += count;
+            } else {
+                int task_completed;
+                MPI_Recv(&task_completed, 1, MPI_INT, status.MPI_SOURCE, FAIL, g->comm, MPI_STATUS_IGNORE);
+            }
+
+            if (solution_found || cancelled) {
+                workers_finished++;
+            } else if (next_task < tot_tasks) {
+                // Ainda há unidades: o trabalhador que terminou recebe a próxima
+                MPI_Send(units[next_task], lengths[next_task], MPI_INT, status.MPI_SOURCE, WORK, g->comm);
+                next_task++;
+            } else {
+                MPI_Send(&next_task, 1, MPI_INT, status.MPI_SOURCE, STOP, g->comm);
+                workers_finished++;
+            }
+        }
+    }
+
+    if (cancelled) {
+        fprintf(out, "PEDIDO CANCELADO\n");
+    } else if (count_all) {
+        fprintf(out, "Total de soluções: %llu\n", solutions);
+    } else if (!solution_found) {
+        // end_time = MPI_Wtime();
+        fprintf(out, "SOLUTION NOT FOUND\n");
+    }
+
+    for (int i = 0; i < tot_tasks; i++) free(units[i]);
+    free(units);
+    free(lengths);
+    return next_task;
+}
+
+// Lógica dos Outros Processadores: Inicia o Processo de busca de uma solução e o encerra
+// No modo MITM a tarefa recebida é a fatia do trabalhador. Se a tabela não couber na memória
+// ou a metade de cima passar do orçamento de nós, todos desistem juntos e cada trabalhador
+// volta para a busca em espiral nas tarefas 0-7 da sua fatia. Quem passa do orçamento na
+// metade de baixo desiste sozinho e faz a espiral inteira, pois os outros podem terminar as
+// suas fatias sem solução.
+int mitm_task(game *g, int share, unsigned int mitm_mb, MPI_Comm worker_comm, int *stop_flag) {
+    int nshares;
+    int found = solve_mitm(g, mitm_mb, share, worker_comm, stop_flag);
+    if (found >= 0) return found;
+    MPI_Comm_size(worker_comm, &nshares);
+    if (found == -3) {
+        fprintf(stderr, "Trabalhador %d: metade de baixo passou de %llu nós, fazendo a busca em espiral inteira\n",
+                share, MITM_NODE_BUDGET);
+        nshares = 1;
+        share = 0;
+    } else if (share == 0 && found == -1) {
+        fprintf(stderr, "Meet-in-the-middle passou de %u MB, voltando para a busca em espiral\n", mitm_mb);
+    } else if (share == 0) {
+        fprintf(stderr, "Meet-in-the-middle passou de %llu nós, voltando para a busca em espiral\n", MITM_NODE_BUDGET);
+    }
+    for (int task = share; task < 8; task += nshares)
+        if (play_first(g, task, stop_flag)) return 1;
+    return 0;
+}
+
+// Mesma coisa para as macro-peças
+int macro_task(game *g, int share, unsigned int mitm_mb, MPI_Comm worker_comm, int *stop_flag) {
+    int nshares;
+    int found = solve_macro(g, mitm_mb, share, worker_comm, stop_flag);
+    if (found >= 0) return found;
+    if (share == 0)
+        fprintf(stderr, "Tabela de macro-peças passou de %u MB, voltando para a busca em espiral\n", mitm_mb);
+    MPI_Comm_size(worker_comm, &nshares);
+    for (int task = share; task < 8; task += nshares)
+        if (play_first(g, task, stop_flag)) return 1;
+    return 0;
+}
+
+void worker_process(game *g, int solver, unsigned int mitm_mb, MPI_Comm worker_comm, int count_all) {
+    int stop_flag = 0;
+    dlx *d = NULL;
+    if (solver == SOLVER_DLX) {
+        d = build_dlx(g, count_all);
+        d->stop_flag = &stop_flag;
+    }
+    MPI_Barrier(g->comm);
+
+    while(!stop_flag) {
+        int task_id = 0, length;
+        MPI_Status status;
+        // As unidades de trabalho têm tamanho variável, então o tamanho é lido antes do Recv
+        MPI_Probe(0, MPI_ANY_TAG, g->comm, &status);
+        MPI_Get_count(&status, MPI_INT, &length);
+        int *unit = malloc(length * sizeof(int));
+        MPI_Recv(unit, length, MPI_INT, 0, status.MPI_TAG, g->comm, &status);
 
         if (status.MPI_TAG == STOP) {
+            free(unit);
             stop_flag = 1;
             continue;
         }
 
-        if (play_first(g, task_id, &stop_flag)) {
+        int found;
+        if (solver == SOLVER_DLX) {
+            d->split_depth = (unsigned int)unit[2];
+            d->branch = unit[1];
+            d->branch_counter = 0;
+            d->solutions = 0;
+            found = dlx_search(d, g, 0);
+        } else if (solver == SOLVER_MITM) {
+            found = mitm_task(g, unit[1], mitm_mb, worker_comm, &stop_flag);
+        } else if (solver == SOLVER_MACRO) {
+            found = macro_task(g, unit[1], mitm_mb, worker_comm, &stop_flag);
+        } else {
+            found = play_unit(g, unit, &stop_flag);
+        }
+        free(unit);
+        if (found) {
             int num_tiles = g->size * g->size;
             solution_tile* tiles_solution = malloc(num_tiles * sizeof(solution_tile));
-            int k = 0;
-            for (unsigned int j = 0; j < g->size; j++) {
-                for (unsigned int i = 0; i < g->size; i++) {
-                    tile* t = g->board[j][i];
-                    tiles_solution[k].id = t->id;
-                    tiles_solution[k].rotation = t->rotation;
-                    k++;
-                }
-            }
-            MPI_Send(tiles_solution, num_tiles * sizeof(solution_tile), MPI_BYTE, 0, FOUND, MPI_COMM_WORLD);
+            pack_solution(g, tiles_solution);
+            MPI_Send(tiles_solution, num_tiles * sizeof(solution_tile), MPI_BYTE, 0, FOUND, g->comm);
             free(tiles_solution);
             stop_flag = 1;
+        } else if (count_all) {
+            MPI_Send(&d->solutions, 1, MPI_UNSIGNED_LONG_LONG, 0, COUNT, g->comm);
         } else {
-            MPI_Send(&task_id, 1, MPI_INT, 0, FAIL, MPI_COMM_WORLD);
+            MPI_Send(&task_id, 1, MPI_INT, 0, FAIL, g->comm);
         }
     }
+    if (d != NULL) free_dlx(d);
 }
 
 int main (int argc, char **argv) {
@@ -453,29 +3167,274 @@ int main (int argc, char **argv) {
   MPI_Init(&argc, &argv);
   MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
   MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+  select_filter();
   
   game *g = NULL;
-  
+  int ordering = ORDER_ID;
+  unsigned int nogood_mb = 0;
+  MPI_Win nogood_win = MPI_WIN_NULL;
+  unsigned long long *nogoods = NULL, nogood_mask = 0;
+  int solver = SOLVER_SPIRAL;
+  unsigned int mitm_mb = 1024; // limite (-b) das tabelas de mitm e de macro
+  unsigned int probes = 0;
+  int count_all = 0;
+  unsigned int endgame_cells = ENDGAME_DEFAULT;
+  const char *daemon_path = NULL;
+  int daemon_mode = 0, queue_policy = QUEUE_FIFO, groups = 0;
+  daemon_state server;
+
+  // Só o P0 interpreta os argumentos, os demais recebem a configuração por broadcast
   if (mpi_rank == 0) {
-      g = initialize(stdin);
-      MPI_Bcast(&g->size, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&g->ncolors, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&g->tile_count, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      MPI_Bcast(g->tiles, g->tile_count * sizeof(tile), MPI_BYTE, 0, MPI_COMM_WORLD);
-      master_process(g, mpi_size);
-  } else {
-      unsigned int bsize, ncolors, tile_count;
-      MPI_Bcast(&bsize, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&ncolors, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      MPI_Bcast(&tile_count, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
-      tile *tiles_data = malloc(tile_count * sizeof(tile));
-      MPI_Bcast(tiles_data, tile_count * sizeof(tile), MPI_BYTE, 0, MPI_COMM_WORLD);
-      g = create_game_worker(bsize, ncolors, tiles_data, tile_count);
-      free(tiles_data);
-      worker_process(g);
+      for (int i = 1; i < argc; i++) {
+          if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+              ordering = parse_ordering(argv[++i]);
+              if (ordering < 0) {
+                  fprintf(stderr, "Heurística de ordenação inválida: %s (use id, rare, constraint ou fails)\n", argv[i]);
+                  MPI_Abort(MPI_COMM_WORLD, 1);
+              }
+          } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+              nogood_mb = (unsigned int)strtoul(argv[++i], NULL, 10);
+          } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+              i++;
+              if (strcmp(argv[i], "spiral") == 0) solver = SOLVER_SPIRAL;
+              else if (strcmp(argv[i], "mitm") == 0) solver = SOLVER_MITM;
+              else if (strcmp(argv[i], "dlx") == 0) solver = SOLVER_DLX;
+              else if (strcmp(argv[i], "auto") == 0) solver = SOLVER_AUTO;
+              else if (strcmp(argv[i], "macro") == 0) solver = SOLVER_MACRO;
+              else {
+                  fprintf(stderr, "Algoritmo inválido: %s (use spiral, mitm, dlx, auto ou macro)\n", argv[i]);
+                  MPI_Abort(MPI_COMM_WORLD, 1);
+              }
+          } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+              mitm_mb = (unsigned int)strtoul(argv[++i], NULL, 10);
+          } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+              probes = (unsigned int)strtoul(argv[++i], NULL, 10);
+          } else if (strcmp(argv[i], "-c") == 0) {
+              count_all = 1;
+          } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+              endgame_cells = (unsigned int)strtoul(argv[++i], NULL, 10);
+              if (endgame_cells > ENDGAME_MAX) {
+                  fprintf(stderr, "Fim de jogo de no máximo %d células (-f)\n", ENDGAME_MAX);
+                  MPI_Abort(MPI_COMM_WORLD, 1);
+              }
+          } else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+              daemon_path = argv[++i];
+              daemon_mode = 1;
+          } else if (strcmp(argv[i], "-q") == 0 && i + 1 < argc) {
+              i++;
+              if (strcmp(argv[i], "fifo") == 0) queue_policy = QUEUE_FIFO;
+              else if (strcmp(argv[i], "small") == 0) queue_policy = QUEUE_SMALL;
+              else {
+                  fprintf(stderr, "Política de fila inválida: %s (use fifo ou small)\n", argv[i]);
+                  MPI_Abort(MPI_COMM_WORLD, 1);
+              }
+          } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+              groups = atoi(argv[++i]);
+          } else {
+              fprintf(stderr, "Uso: %s [-o id|rare|constraint|fails] [-m MB_nogoods_por_no] [-s spiral|mitm|dlx|auto|macro] [-b MB_tabela] [-e amostras] [-c] [-f celulas_fim] [-d socket [-q fifo|small] [-g grupos]] < entrada\n", argv[0]);
+              MPI_Abort(MPI_COMM_WORLD, 1);
+          }
+      }
+      if (count_all && solver != SOLVER_DLX) {
+          fprintf(stderr, "A contagem de soluções (-c) só existe com -s dlx\n");
+          MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      // Por padrão, um grupo para cada três processos além do P0
+      if (daemon_mode && groups == 0) groups = (mpi_size - 1) / 3 > 0 ? (mpi_size - 1) / 3 : 1;
+      if (groups != 0 && !daemon_mode) {
+          fprintf(stderr, "Os grupos (-g) só existem no modo servidor (-d)\n");
+          MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      if (daemon_mode && (groups < 0 || 2 * groups > mpi_size - 1)) {
+          fprintf(stderr, "Cada grupo precisa de um líder e de um trabalhador: %d processos além do P0 não formam %d grupos\n",
+                  mpi_size - 1, groups);
+          MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+      if (daemon_mode && daemon_open(&server, daemon_path, queue_policy, groups, mpi_size) < 0) {
+          fprintf(stderr, "Não foi possível abrir o socket %s\n", daemon_path);
+          MPI_Abort(MPI_COMM_WORLD, 1);
+      }
   }
-  
+  MPI_Bcast(&ordering, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&nogood_mb, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&solver, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&mitm_mb, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&count_all, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&endgame_cells, 1, MPI_UNSIGNED, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&daemon_mode, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  MPI_Bcast(&groups, 1, MPI_INT, 0, MPI_COMM_WORLD);
+  // No modo normal todos os processos formam um grupo só, com o P0 de líder. No modo servidor o
+  // P0 fica fora dos grupos e só atende os sockets.
+  MPI_Comm group_comm = MPI_COMM_WORLD, worker_comm = MPI_COMM_NULL;
+  int group_rank = mpi_rank, group_size = mpi_size;
+  if (daemon_mode) {
+    MPI_Comm_split(MPI_COMM_WORLD, mpi_rank == 0 ? MPI_UNDEFINED : daemon_group(mpi_rank, mpi_size, groups), mpi_rank,
+                   &group_comm);
+    if (group_comm != MPI_COMM_NULL) {
+      MPI_Comm_rank(group_comm, &group_rank);
+      MPI_Comm_size(group_comm, &group_size);
+    }
+  }
+  if (group_comm != MPI_COMM_NULL) {
+    // Comunicador só com os trabalhadores do grupo, usado pelas operações coletivas do MITM
+    MPI_Comm_split(group_comm, group_rank == 0 ? MPI_UNDEFINED : 0, group_rank, &worker_comm);
+    // A tabela de nogoods é criada uma vez por grupo e dura todos os pedidos dele
+    if (nogood_mb > 0) nogood_win = create_nogood_window(group_comm, nogood_mb, &nogoods, &nogood_mask);
+  }
+  if (daemon_mode && mpi_rank == 0) daemon_serve(&server);
+
+  // Cada volta resolve um tabuleiro: no modo normal o da entrada padrão, no modo servidor o
+  // pedido que o P0 mandou ao líder do grupo, até o P0 dispensar o grupo com STOP
+  unsigned long long request_seed = 0;
+  for (int more = (group_comm != MPI_COMM_NULL); more; more = daemon_mode) {
+    char *request = NULL;
+    int request_length = 0;
+    if (daemon_mode) {
+      if (group_rank == 0) {
+        // Um CANCEL que chega com o grupo livre é de um pedido que já foi respondido
+        MPI_Status status;
+        int ignored;
+        MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        while (status.MPI_TAG == CANCEL) {
+          MPI_Recv(&ignored, 1, MPI_INT, 0, CANCEL, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+          MPI_Probe(0, MPI_ANY_TAG, MPI_COMM_WORLD, &status);
+        }
+        more = (status.MPI_TAG == REQUEST);
+        if (more) {
+          MPI_Get_count(&status, MPI_CHAR, &request_length);
+          request = malloc(request_length + 1);
+          assert(request != NULL);
+          MPI_Recv(request, request_length, MPI_CHAR, 0, REQUEST, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        } else {
+          MPI_Recv(&ignored, 1, MPI_INT, 0, STOP, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        }
+      }
+      MPI_Bcast(&more, 1, MPI_INT, 0, group_comm);
+      if (!more) break;
+    }
+    int run_solver = solver;
+
+    if (group_rank == 0) {
+        FILE *input = stdin, *out = stdout;
+        char *reply = NULL;
+        size_t reply_length = 0;
+        double request_start = MPI_Wtime();
+        if (daemon_mode) {
+            input = fmemopen(request, request_length, "r");
+            out = open_memstream(&reply, &reply_length);
+            assert(input != NULL && out != NULL);
+        }
+        g = initialize(input, ordering, g);
+        g->endgame = endgame_cells;
+        g->comm = group_comm;
+        MPI_Bcast(&g->size, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(&g->ncolors, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(&g->tile_count, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(g->tiles, g->tile_count * sizeof(tile), MPI_BYTE, 0, group_comm);
+        // As dicas vão como (x, y, id, rotação), lidas da ordem de visita, onde ficam no início
+        unsigned int *clues = malloc((g->clues * 4 + 1) * sizeof(unsigned int));
+        assert(clues != NULL);
+        for (unsigned int d = 0; d < g->clues; d++) {
+            const visit *v = &g->spiral[0][d];
+            clues[4 * d] = v->x;
+            clues[4 * d + 1] = v->y;
+            clues[4 * d + 2] = g->board[v->y][v->x]->id;
+            clues[4 * d + 3] = g->board[v->y][v->x]->rotation;
+        }
+        MPI_Bcast(&g->clues, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(clues, g->clues * 4, MPI_UNSIGNED, 0, group_comm);
+        free(clues);
+        if (run_solver == SOLVER_MITM && g->clues) {
+            fprintf(stderr, "Meet-in-the-middle não aceita dicas, usando a busca em espiral\n");
+            run_solver = SOLVER_SPIRAL;
+        }
+        if (run_solver == SOLVER_MACRO && (g->size % 2 || g->clues)) {
+            fprintf(stderr, "Macro-peças 2x2 precisam de lado par e sem dicas, usando a busca em espiral\n");
+            run_solver = SOLVER_SPIRAL;
+        }
+        int first_choice = -1, units = 0;
+        solution_tile *probe_solution = NULL;
+        if (run_solver == SOLVER_AUTO) {
+            probe_solution = malloc(g->tile_count * sizeof(solution_tile));
+            assert(probe_solution != NULL);
+            first_choice = auto_select(g, group_rank, group_size, probe_solution);
+            run_solver = SOLVER_SPIRAL;
+        }
+        // Se as sondas já responderam, os trabalhadores nem entram em worker_process
+        if (first_choice == AUTO_SOLVED)
+            print_solution(out, probe_solution, g->size);
+        else if (first_choice == AUTO_NO_SOLUTION)
+            fprintf(out, "SOLUTION NOT FOUND\n");
+        else
+            units = master_process(g, group_size, run_solver, probes, count_all, first_choice, out, daemon_mode);
+        free(probe_solution);
+        if (daemon_mode) {
+            for (int rank = 1; rank < group_size; rank++) MPI_Send(&units, 1, MPI_INT, rank, DONE, group_comm);
+            fprintf(out, "Execution time: %f seconds\n", MPI_Wtime() - request_start);
+            fprintf(out, "%d unidades em %d trabalhadores\n", units, group_size - 1);
+            fclose(out);
+            fclose(input);
+            MPI_Send(reply, (int)reply_length, MPI_CHAR, 0, REPLY, MPI_COMM_WORLD);
+            free(reply);
+        }
+    } else {
+        unsigned int bsize, ncolors, tile_count;
+        MPI_Bcast(&bsize, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(&ncolors, 1, MPI_UNSIGNED, 0, group_comm);
+        MPI_Bcast(&tile_count, 1, MPI_UNSIGNED, 0, group_comm);
+        tile *tiles_data = malloc(tile_count * sizeof(tile));
+        MPI_Bcast(tiles_data, tile_count * sizeof(tile), MPI_BYTE, 0, group_comm);
+        unsigned int nclues;
+        MPI_Bcast(&nclues, 1, MPI_UNSIGNED, 0, group_comm);
+        unsigned int *clues = malloc((nclues * 4 + 1) * sizeof(unsigned int));
+        assert(clues != NULL);
+        MPI_Bcast(clues, nclues * 4, MPI_UNSIGNED, 0, group_comm);
+        g = create_game_worker(bsize, ncolors, tiles_data, tile_count, ordering, nclues, clues, g);
+        g->endgame = endgame_cells;
+        g->comm = group_comm;
+        free(tiles_data);
+        free(clues);
+        if (run_solver == SOLVER_MITM && nclues) run_solver = SOLVER_SPIRAL;
+        if (run_solver == SOLVER_MACRO && (bsize % 2 || nclues)) run_solver = SOLVER_SPIRAL;
+        int settled = 0;
+        if (run_solver == SOLVER_AUTO) {
+            solution_tile *probe_solution = malloc(g->tile_count * sizeof(solution_tile));
+            assert(probe_solution != NULL);
+            int choice = auto_select(g, group_rank, group_size, probe_solution);
+            settled = (choice == AUTO_SOLVED || choice == AUTO_NO_SOLUTION);
+            free(probe_solution);
+            run_solver = SOLVER_SPIRAL;
+        }
+        // As chaves Zobrist se repetem entre tabuleiros do mesmo tamanho, então no modo servidor
+        // cada pedido começa o hash de um valor próprio: os nogoods dos pedidos anteriores deixam
+        // de casar e a tabela não precisa ser zerada
+        if (daemon_mode) g->hash ^= splitmix64(&request_seed);
+        g->nogoods = nogoods;
+        g->nogood_mask = nogood_mask;
+        if (!settled) worker_process(g, run_solver, mitm_mb, worker_comm, count_all);
+        if (daemon_mode) {
+            // Descarta os STOP que sobraram deste pedido; o DONE é sempre o último
+            MPI_Status status;
+            do {
+                int ignored;
+                MPI_Recv(&ignored, 1, MPI_INT, 0, MPI_ANY_TAG, group_comm, &status);
+            } while (status.MPI_TAG != DONE);
+        }
+    }
+
+    free(request);
+    // No modo servidor o jogo fica para o próximo pedido (game_shell)
+    if (!daemon_mode) {
+        free_resources(g);
+        g = NULL;
+    }
+  }
+
   free_resources(g);
+  if (mpi_rank == 0 && daemon_mode) daemon_close(&server);
+  if (worker_comm != MPI_COMM_NULL) MPI_Comm_free(&worker_comm);
+  if (nogood_win != MPI_WIN_NULL) MPI_Win_free(&nogood_win);
+  if (daemon_mode && group_comm != MPI_COMM_NULL) MPI_Comm_free(&group_comm);
   MPI_Finalize();
   return 0;
-}
\ No newline at end of file
+}
@@ -11,20 +11,55 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <time.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+// Heurísticas de ordenação dos candidatos dentro de cada bucket de cor (opção -o)
+#define ORDER_ID 0         // ordem original, pelo id da peça
+#define ORDER_RARE 1       // peças com cores mais raras primeiro
+#define ORDER_CONSTRAINT 2 // peças que casam com menos outras peças primeiro
+#define ORDER_FAILS 3      // adaptativa: peças que menos falharam primeiro
+
+// Algoritmos de busca disponíveis (opção -s)
+#define SOLVER_SPIRAL 0 // backtracking em espiral (play_table)
+#define SOLVER_MITM 1   // meet-in-the-middle entre a metade de cima e a de baixo
+#define SOLVER_DLX 2    // cobertura exata com Dancing Links (algoritmo X com cores)
+#define SOLVER_AUTO 3   // sondas curtas escolhem ordenação, sentido e canto da espiral
+#define SOLVER_MACRO 4  // busca em blocos 2x2 pré-computados, num tabuleiro com metade do lado
 
 typedef struct {
   unsigned int colors[4];
   unsigned char rotation;
   unsigned int id;
   int used;
+  unsigned int score; // chave de ordenação dos buckets (menor é tentada antes)
+  unsigned int fails; // quantas vezes a subárvore dessa peça falhou (só contado com -o fails)
 } tile;
 
 typedef struct {
   tile **tiles;
   unsigned int count;
   unsigned int capacity;
+  unsigned char *edges[4]; // Cor N/E/S/W de cada (peça, rotação), na posição i * 4 + rotação
 } tile_list;
 
+// Situação de cada lado de uma célula quando ela é visitada
+#define SIDE_BORDER 0 // borda do tabuleiro, exige cor 0
+#define SIDE_FREE 1   // vizinho ainda vazio
+#define SIDE_PLACED 2 // vizinho já colocado antes na ordem de visita
+
+// Célula da ordem de visita. from é o lado (0 N, 1 E, 2 S, 3 W) do vizinho já colocado que
+// define o bucket de candidatos (-1 na primeira célula).
+typedef struct {
+  unsigned int x, y;
+  int from;
+  unsigned char side[4]; // SIDE_* de cada lado
+  tile **slot;           // posição da célula no tabuleiro
+  tile **neighbor[4];    // posição de cada vizinho no tabuleiro (NULL na borda)
+} visit;
+
 typedef struct {
   unsigned int size;
   unsigned int tile_count;
@@ -33,6 +68,15 @@ typedef struct {
   tile *tiles;
   tile_list **color_buckets; // Array de listas por cor
   tile_list *tiles_vertice;   // Lista de peças de vértice (com 2 zeros)
+  int ordering; // Heurística de ordenação dos candidatos (ORDER_*)
+  unsigned long long hash;          // Hash Zobrist do estado atual (peças usadas + cores da fronteira)
+  unsigned long long *zobrist_tile; // Chave de cada peça
+  unsigned long long *zobrist_edge; // Chave de cada par (aresta interna, cor)
+  unsigned long long *nogoods;      // Tabela de estados sem solução (NULL se desativada)
+  unsigned long long nogood_mask;   // Número de posições da tabela - 1
+  visit *spiral[2]; // Ordem de visita da espiral normal (0) e da inversa (1)
+  unsigned int clues; // Peças fixas pela entrada, que ocupam o início das ordens de visita
+  unsigned int endgame; // Células restantes em que a busca passa para solve_endgame (0 desativa)
 } game;
 
 #define X_COLOR(t, s) (t->colors[(s + 4 - t->rotation) % 4])
@@ -41,6 +85,16 @@ typedef struct {
 #define S_COLOR(t) (X_COLOR(t, 2))
 #define W_COLOR(t) (X_COLOR(t, 3))
 
+// Índice da aresta entre (x,y) e (x+1,y) e da aresta entre (x,y) e (x,y+1)
+#define H_EDGE(g, x, y) ((y) * ((g)->size - 1) + (x))
+#define V_EDGE(g, x, y) ((g)->size * ((g)->size - 1) + (y) * (g)->size + (x))
+
+#define NOGOOD_WAYS 4 // Posições consultadas por hash na tabela de nogoods
+
+#define MAX_BOARD_SIZE 128 // maior lado aceito: o MITM guarda id * 4 + rotação em 16 bits
+
+#define ANY_COLOR 0xFFFFu // Lado da célula sem restrição (vizinho ainda vazio)
+
 // Adiciona uma peça a uma lista passada deevitando repetir
 void add_tile(tile_list *list, tile *t) {
   for (unsigned int i = 0; i < list->count; i++) {
@@ -94,12 +148,407 @@ void find_vertex(game *g) {
     }
   }
 }
+// Preenche, para cada célula da ordem, a situação de cada lado no momento da visita e os
+// ponteiros para a célula e os vizinhos no tabuleiro, usados por play_table
+void link_visit_order(game *g, visit *order) {
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  unsigned int n = g->size;
+  unsigned int *position = malloc(g->tile_count * sizeof(unsigned int));
+  assert(position != NULL);
+  for (unsigned int d = 0; d < g->tile_count; d++) position[order[d].y * n + order[d].x] = d;
+  for (unsigned int d = 0; d < g->tile_count; d++) {
+    visit *v = &order[d];
+    v->slot = &g->board[v->y][v->x];
+    for (int s = 0; s < 4; s++) {
+      int nx = (int)v->x + dx[s], ny = (int)v->y + dy[s];
+      if (nx < 0 || ny < 0 || nx >= (int)n || ny >= (int)n) {
+        v->side[s] = SIDE_BORDER;
+        v->neighbor[s] = NULL;
+      } else {
+        v->side[s] = position[ny * n + nx] < d ? SIDE_PLACED : SIDE_FREE;
+        v->neighbor[s] = &g->board[ny][nx];
+      }
+    }
+  }
+  free(position);
+}
+
+// Calcula a ordem em que a espiral normal (inversa = 0) ou a anti-horária (inversa = 1) visita
+// as células a partir do canto (0,0)
+void build_visit_order(game *g, int inversa, visit *order) {
+  unsigned int n = g->size, x = 0, y = 0;
+  char *filled = calloc(g->tile_count, 1);
+  assert(filled != NULL);
+  order[0].x = 0; order[0].y = 0; order[0].from = -1;
+  filled[0] = 1;
+  for (unsigned int d = 1; d < g->tile_count; d++) {
+    int from;
+    if (!inversa) {
+      if (x < n - 1 && !filled[y * n + x + 1] && (y == 0 || filled[(y - 1) * n + x])) { x++; from = 3; }
+      else if (y < n - 1 && !filled[(y + 1) * n + x]) { y++; from = 0; }
+      else if (x > 0 && !filled[y * n + x - 1]) { x--; from = 1; }
+      else { y--; from = 2; }
+    } else {
+      if (y < n - 1 && !filled[(y + 1) * n + x] && (x == 0 || filled[y * n + x - 1])) { y++; from = 0; }
+      else if (x < n - 1 && !filled[y * n + x + 1]) { x++; from = 3; }
+      else if (y > 0 && !filled[(y - 1) * n + x]) { y--; from = 2; }
+      else { x--; from = 1; }
+    }
+    assert(!filled[y * n + x]);
+    filled[y * n + x] = 1;
+    order[d].x = x; order[d].y = y; order[d].from = from;
+  }
+  free(filled);
+  link_visit_order(g, order);
+}
+
+// Cor exigida pelo vizinho do lado from da célula, que indica o bucket de candidatos
+unsigned int visit_color(game *g, const visit *v) {
+  if (v->from < 0) return 0;
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  tile *neighbor = g->board[v->y + dy[v->from]][v->x + dx[v->from]];
+  return X_COLOR(neighbor, (v->from + 2) % 4);
+}
+
+// Ordem de visita com dicas: primeiro as células fixas, depois o canto (0,0) se estiver livre e
+// então sempre a célula livre mais restrita (vizinhos já colocados + lados de borda) entre as que
+// têm algum vizinho colocado, com empate decidido pela posição na espiral. Assim os vizinhos das
+// dicas entram assim que a busca encosta nelas e já são podados contra as cores fixas.
+void build_clue_order(game *g, int inversa, visit *order) {
+  static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+  unsigned int n = g->size, d = 0;
+  unsigned int *rank = malloc(g->tile_count * sizeof(unsigned int));
+  char *filled = calloc(g->tile_count, 1);
+  assert(rank != NULL && filled != NULL);
+  build_visit_order(g, inversa, order);
+  for (unsigned int i = 0; i < g->tile_count; i++) rank[order[i].y * n + order[i].x] = i;
+
+  for (unsigned int y = 0; y < n; y++)
+    for (unsigned int x = 0; x < n; x++)
+      if (g->board[y][x] != NULL) {
+        order[d].x = x; order[d].y = y; order[d].from = -1;
+        filled[y * n + x] = 1;
+        d++;
+      }
+  if (!filled[0]) {
+    order[d].x = 0; order[d].y = 0; order[d].from = -1;
+    filled[0] = 1;
+    d++;
+  }
+  for (; d < g->tile_count; d++) {
+    unsigned int best = g->tile_count;
+    int best_score = -1, best_from = -1;
+    for (unsigned int c = 0; c < g->tile_count; c++) {
+      if (filled[c]) continue;
+      int x = c % n, y = c / n, score = 0, from = -1;
+      for (int s = 0; s < 4; s++) {
+        int nx = x + dx[s], ny = y + dy[s];
+        if (nx < 0 || ny < 0 || nx >= (int)n || ny >= (int)n) score++;
+        else if (filled[ny * n + nx]) { score++; if (from < 0) from = s; }
+      }
+      if (from < 0) continue;
+      if (score > best_score || (score == best_score && rank[c] < rank[best])) {
+        best = c; best_score = score; best_from = from;
+      }
+    }
+    assert(best < g->tile_count);
+    order[d].x = best % n; order[d].y = best / n; order[d].from = best_from;
+    filled[best] = 1;
+  }
+
+  free(rank);
+  free(filled);
+  link_visit_order(g, order);
+}
+
+// Empacota as cores de todas as rotações de cada bucket em vetores de bytes, um por lado,
+// para o filtro de candidatos comparar um bucket inteiro de uma vez. Precisa ser refeito
+// sempre que a ordem dos buckets mudar. O tamanho é arredondado para 32 (um registrador AVX2).
+void pack_buckets(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    unsigned int padded = (list->count * 4 + 31) & ~31u;
+    for (int s = 0; s < 4; s++) {
+      free(list->edges[s]);
+      list->edges[s] = calloc(padded + 32, 1);
+      assert(list->edges[s] != NULL);
+    }
+    for (unsigned int i = 0; i < list->count; i++) {
+      tile *t = list->tiles[i];
+      for (unsigned int rot = 0; rot < 4; rot++)
+        for (int s = 0; s < 4; s++)
+          list->edges[s][i * 4 + rot] = (unsigned char)t->colors[(s + 4 - rot) % 4];
+    }
+  }
+}
+
+// Filtros de candidatos: marcam em valid o bit i * 4 + rotação de cada (peça, rotação) do
+// bucket cujas cores batem com req (ANY_COLOR = lado livre). valid já vem zerado.
+void filter_scalar(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  for (unsigned int k = 0; k < list->count * 4; k++) {
+    int ok = 1;
+    for (int s = 0; s < 4 && ok; s++)
+      if (req[s] != ANY_COLOR && list->edges[s][k] != req[s]) ok = 0;
+    if (ok) valid[k / 64] |= 1ULL << (k % 64);
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// 16 rotações por iteração, disponível em todo x86-64
+__attribute__((target("sse2")))
+void filter_sse2(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  __m128i want[4];
+  int active[4], nactive = 0;
+  for (int s = 0; s < 4; s++)
+    if (req[s] != ANY_COLOR) {
+      active[nactive] = s;
+      want[nactive++] = _mm_set1_epi8((char)req[s]);
+    }
+  for (unsigned int k = 0; k < list->count * 4; k += 16) {
+    __m128i ok = _mm_set1_epi8(-1);
+    for (int a = 0; a < nactive; a++) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(list->edges[active[a]] + k));
+      ok = _mm_and_si128(ok, _mm_cmpeq_epi8(v, want[a]));
+    }
+    valid[k / 64] |= (unsigned long long)(unsigned int)_mm_movemask_epi8(ok) << (k % 64);
+  }
+}
+
+// 32 rotações por iteração
+__attribute__((target("avx2")))
+void filter_avx2(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  __m256i want[4];
+  int active[4], nactive = 0;
+  for (int s = 0; s < 4; s++)
+    if (req[s] != ANY_COLOR) {
+      active[nactive] = s;
+      want[nactive++] = _mm256_set1_epi8((char)req[s]);
+    }
+  for (unsigned int k = 0; k < list->count * 4; k += 32) {
+    __m256i ok = _mm256_set1_epi8(-1);
+    for (int a = 0; a < nactive; a++) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(list->edges[active[a]] + k));
+      ok = _mm256_and_si256(ok, _mm256_cmpeq_epi8(v, want[a]));
+    }
+    valid[k / 64] |= (unsigned long long)(unsigned int)_mm256_movemask_epi8(ok) << (k % 64);
+  }
+}
+#endif
+
+// Filtro escolhido em tempo de execução por select_filter, conforme a CPU
+void (*filter_bucket)(tile_list *, const unsigned int[4], unsigned long long *) = filter_scalar;
+
+void select_filter(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) filter_bucket = filter_avx2;
+  else if (__builtin_cpu_supports("sse2")) filter_bucket = filter_sse2;
+#endif
+}
+
+// Filtra o bucket com as restrições req. valid precisa ter count / 16 + 1 palavras.
+static inline void filter_masked(tile_list *list, const unsigned int req[4], unsigned long long *valid) {
+  memset(valid, 0, (list->count / 16 + 1) * sizeof(unsigned long long));
+  filter_bucket(list, req, valid);
+  // Os bytes de preenchimento depois da última peça podem ter batido com a cor 0
+  if ((list->count * 4) % 64) valid[list->count / 16] &= (1ULL << ((list->count * 4) % 64)) - 1;
+}
+
+// Monta as restrições da célula (x,y) (borda exige cor 0, vizinho colocado exige a cor dele)
+// e filtra o bucket. valid precisa ter count / 16 + 1 palavras.
+void filter_candidates(game *game, tile_list *list, unsigned int x, unsigned int y, unsigned long long *valid) {
+  unsigned int req[4];
+  req[0] = (y == 0) ? 0 : (game->board[y - 1][x] ? S_COLOR(game->board[y - 1][x]) : ANY_COLOR);
+  req[1] = (x == game->size - 1) ? 0 : (game->board[y][x + 1] ? W_COLOR(game->board[y][x + 1]) : ANY_COLOR);
+  req[2] = (y == game->size - 1) ? 0 : (game->board[y + 1][x] ? N_COLOR(game->board[y + 1][x]) : ANY_COLOR);
+  req[3] = (x == 0) ? 0 : (game->board[y][x - 1] ? E_COLOR(game->board[y][x - 1]) : ANY_COLOR);
+  filter_masked(list, req, valid);
+}
+
+// Mesmas restrições, lidas da tabela da ordem de visita. Retorna o bucket de candidatos.
+static inline tile_list *visit_requirements(game *g, const visit *v, unsigned int req[4]) {
+  for (int s = 0; s < 4; s++) {
+    if (v->side[s] == SIDE_BORDER) req[s] = 0;
+    else if (v->side[s] == SIDE_PLACED) req[s] = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+    else req[s] = ANY_COLOR;
+  }
+  return g->color_buckets[v->from < 0 ? 0 : req[v->from]];
+}
+
+// Critério do qsort: menor score primeiro, empate decidido pelo id para manter a ordem estável
+int compare_tiles(const void *a, const void *b) {
+  const tile *ta = *(tile * const *)a;
+  const tile *tb = *(tile * const *)b;
+  if (ta->score != tb->score) return (ta->score < tb->score) ? -1 : 1;
+  return (ta->id < tb->id) ? -1 : (ta->id > tb->id);
+}
+// Reordena todos os buckets pelo score atual das peças
+void sort_buckets(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    qsort(list->tiles, list->count, sizeof(tile*), compare_tiles);
+  }
+}
+// Confere se cada bucket está em ordem de (score, id)
+int buckets_sorted(game *g) {
+  for (unsigned int c = 0; c < g->ncolors; c++) {
+    tile_list *list = g->color_buckets[c];
+    for (unsigned int k = 1; k < list->count; k++)
+      if (compare_tiles(&list->tiles[k - 1], &list->tiles[k]) > 0) return 0;
+  }
+  return 1;
+}
+// Calcula o score de cada peça conforme a heurística escolhida e ordena os buckets.
+// RARE: soma da frequência das cores da peça (cores raras dão score baixo).
+// CONSTRAINT: quantas outras peças compartilham alguma cor não cinza com ela.
+// FAILS: começa na ordem do id e é atualizada durante a busca por reorder_buckets.
+void order_candidates(game *g) {
+  unsigned int *freq = calloc(g->ncolors, sizeof(unsigned int));
+  unsigned int *mark = malloc(g->tile_count * sizeof(unsigned int));
+  assert(freq != NULL && mark != NULL);
+  for (unsigned int i = 0; i < g->tile_count; i++) {
+    mark[i] = g->tile_count;
+    for (int c = 0; c < 4; c++)
+      if (g->tiles[i].colors[c] < g->ncolors) freq[g->tiles[i].colors[c]]++;
+  }
+
+  for (unsigned int i = 0; i < g->tile_count; i++) {
+    tile *t = &g->tiles[i];
+    t->score = 0;
+    t->fails = 0;
+    if (g->ordering == ORDER_RARE) {
+      for (int c = 0; c < 4; c++)
+        if (t->colors[c] != 0 && t->colors[c] < g->ncolors) t->score += freq[t->colors[c]];
+    } else if (g->ordering == ORDER_CONSTRAINT) {
+      for (int c = 0; c < 4; c++) {
+        if (t->colors[c] == 0 || t->colors[c] >= g->ncolors) continue;
+        tile_list *list = g->color_buckets[t->colors[c]];
+        for (unsigned int k = 0; k < list->count; k++) {
+          if (list->tiles[k] != t && mark[list->tiles[k]->id] != i) {
+            mark[list->tiles[k]->id] = i;
+            t->score++;
+          }
+        }
+      }
+    }
+  }
+  free(freq);
+  free(mark);
+
+  // Sempre reordena: com ORDER_ID todos os scores são 0 e o desempate pelo id volta à ordem
+  // original, mesmo que uma sonda de -s auto tenha deixado os buckets em outra ordem
+  sort_buckets(g);
+  assert(buckets_sorted(g));
+  pack_buckets(g);
+}
+// Ordenação adaptativa: usa as falhas acumuladas como score. Só pode ser chamada entre
+// subárvores da raiz, pois play_table percorre os buckets por índice.
+void reorder_buckets(game *g) {
+  if (g->ordering != ORDER_FAILS) return;
+  for (unsigned int i = 0; i < g->tile_count; i++)
+    g->tiles[i].score = g->tiles[i].fails;
+  sort_buckets(g);
+  pack_buckets(g);
+}
+// Gerador splitmix64. A semente é fixa para que as chaves sejam sempre as mesmas
+unsigned long long splitmix64(unsigned long long *state) {
+  unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+// Sorteia as chaves Zobrist. O hash de um estado é o XOR das chaves das peças usadas com as
+// chaves (aresta, cor) das arestas que têm exatamente um lado ocupado, ou seja, a fronteira.
+void init_zobrist(game *g) {
+  unsigned long long seed = 0x2545F4914F6CDD1DULL;
+  unsigned int edge_keys = 2 * g->size * (g->size - 1) * g->ncolors;
+  g->hash = 0;
+  g->zobrist_tile = malloc(g->tile_count * sizeof(unsigned long long));
+  g->zobrist_edge = malloc((edge_keys + 1) * sizeof(unsigned long long));
+  assert(g->zobrist_tile != NULL && g->zobrist_edge != NULL);
+  for (unsigned int i = 0; i < g->tile_count; i++) g->zobrist_tile[i] = splitmix64(&seed);
+  for (unsigned int i = 0; i < edge_keys; i++) g->zobrist_edge[i] = splitmix64(&seed);
+}
+// Coloca ou retira a peça t de (x,y) no hash (o XOR é o próprio inverso). Cada aresta entra
+// no hash quando o primeiro vizinho é colocado e sai quando o segundo fecha a aresta.
+void zobrist_toggle(game *g, unsigned int x, unsigned int y, tile *t) {
+  unsigned long long *k = g->zobrist_edge;
+  unsigned int nc = g->ncolors;
+  unsigned long long h = g->hash ^ g->zobrist_tile[t->id];
+  if (x > 0) h ^= k[H_EDGE(g, x - 1, y) * nc + W_COLOR(t)];
+  if (x < g->size - 1) h ^= k[H_EDGE(g, x, y) * nc + E_COLOR(t)];
+  if (y > 0) h ^= k[V_EDGE(g, x, y - 1) * nc + N_COLOR(t)];
+  if (y < g->size - 1) h ^= k[V_EDGE(g, x, y) * nc + S_COLOR(t)];
+  g->hash = h;
+}
+// Aloca a tabela de nogoods com até mb megabytes (arredondado para potência de 2)
+void init_nogoods(game *g, unsigned int mb) {
+  g->nogoods = NULL;
+  g->nogood_mask = 0;
+  if (mb == 0) return;
+  unsigned long long slots = NOGOOD_WAYS;
+  while (slots * 2 * sizeof(unsigned long long) <= (unsigned long long)mb << 20) slots *= 2;
+  g->nogoods = calloc(slots, sizeof(unsigned long long));
+  assert(g->nogoods != NULL);
+  g->nogood_mask = slots - 1;
+}
+// Estado atual já foi provado sem solução? O hash completo fica guardado (0 marca posição vazia)
+int nogood_lookup(game *g) {
+  if (g->nogoods == NULL) return 0;
+  unsigned long long key = g->hash ? g->hash : 1;
+  unsigned long long *set = &g->nogoods[key & g->nogood_mask & ~(NOGOOD_WAYS - 1ULL)];
+  for (int i = 0; i < NOGOOD_WAYS; i++)
+    if (set[i] == key) return 1;
+  return 0;
+}
+// Guarda o estado atual como sem solução, usando posição vazia ou substituindo uma qualquer
+void nogood_store(game *g) {
+  if (g->nogoods == NULL) return;
+  unsigned long long key = g->hash ? g->hash : 1;
+  unsigned long long *set = &g->nogoods[key & g->nogood_mask & ~(NOGOOD_WAYS - 1ULL)];
+  for (int i = 0; i < NOGOOD_WAYS; i++) {
+    if (set[i] == 0) {
+      set[i] = key;
+      return;
+    }
+  }
+  set[(key >> 62) & (NOGOOD_WAYS - 1)] = key;
+}
+// Converte o nome da heurística passado em -o
+int parse_ordering(const char *name) {
+  if (strcmp(name, "id") == 0) return ORDER_ID;
+  if (strcmp(name, "rare") == 0) return ORDER_RARE;
+  if (strcmp(name, "constraint") == 0) return ORDER_CONSTRAINT;
+  if (strcmp(name, "fails") == 0) return ORDER_FAILS;
+  return -1;
+}
+
+int valid_move (game *game, unsigned int x, unsigned int y, tile *tile);
+
+// Fixa no tabuleiro as dicas lidas da entrada, nclues grupos de (x, y, id, rotação). As peças
+// ficam marcadas como usadas e entram no hash; a busca nunca as desfaz.
+void place_clues(game *g, unsigned int nclues, const unsigned int *clues) {
+  g->clues = nclues;
+  for (unsigned int i = 0; i < nclues; i++) {
+    unsigned int x = clues[4 * i], y = clues[4 * i + 1], id = clues[4 * i + 2];
+    assert(x < g->size && y < g->size && id < g->tile_count && clues[4 * i + 3] < 4);
+    tile *t = &g->tiles[id];
+    assert(!t->used && g->board[y][x] == NULL);
+    t->rotation = clues[4 * i + 3];
+    assert(valid_move(g, x, y, t));
+    t->used = 1;
+    g->board[y][x] = t;
+    zobrist_toggle(g, x, y, t);
+  }
+}
+
 // Aqui eu respeitei em grande parte logica do prof, apenas adicionei numero de cores e chamei as funções acima
-game *initialize (FILE *input) {
+game *initialize (FILE *input, int ordering, unsigned int nogood_mb) {
   unsigned int bsize;
   unsigned int ncolors;
   int r = fscanf (input, "%u", &bsize);
   assert (r == 1);
+  assert (bsize > 0 && bsize <= MAX_BOARD_SIZE);
   r = fscanf (input, "%u", &ncolors);
   assert (r == 1);
   assert (ncolors < 256);
@@ -109,6 +558,7 @@ game *initialize (FILE *input) {
   g->ncolors = ncolors + 1;
   g->size = bsize;
   g->tile_count = bsize * bsize;
+  g->ordering = ordering;
   g->board = malloc (sizeof (tile**) * bsize);
   for(unsigned int i = 0; i < bsize; i++)
     g->board[i] = calloc(bsize, sizeof(tile*));
@@ -124,8 +574,33 @@ game *initialize (FILE *input) {
     }
   }
 
+  // Seção opcional de dicas depois das peças: a quantidade e então "x y id rotação" de cada
+  // peça fixa (x é a coluna e y a linha, contando de 0)
+  unsigned int nclues = 0;
+  unsigned int *clues = NULL;
+  if (fscanf(input, "%u", &nclues) == 1 && nclues > 0) {
+    assert(nclues <= g->tile_count);
+    clues = malloc(nclues * 4 * sizeof(unsigned int));
+    assert(clues != NULL);
+    for (unsigned int i = 0; i < nclues * 4; i++) {
+      r = fscanf(input, "%u", &clues[i]);
+      assert(r == 1);
+    }
+  }
+
   create_color_list(g);
   find_vertex(g);
+  order_candidates(g);
+  init_zobrist(g);
+  place_clues(g, nclues, clues);
+  free(clues);
+  init_nogoods(g, nogood_mb);
+  for (int inversa = 0; inversa < 2; inversa++) {
+    g->spiral[inversa] = malloc(g->tile_count * sizeof(visit));
+    assert(g->spiral[inversa] != NULL);
+    if (g->clues) build_clue_order(g, inversa, g->spiral[inversa]);
+    else build_visit_order(g, inversa, g->spiral[inversa]);
+  }
 
   return g;
 }
@@ -144,12 +619,19 @@ void free_resources(game *game) {
         if (game->color_buckets[i]->tiles) {
           free(game->color_buckets[i]->tiles);
         }
+        for (int s = 0; s < 4; s++)
+          free(game->color_buckets[i]->edges[s]);
         free(game->color_buckets[i]);
       }
     }
     free(game->color_buckets);
   }
 
+  free(game->zobrist_tile);
+  free(game->zobrist_edge);
+  free(game->nogoods);
+  free(game->spiral[0]);
+  free(game->spiral[1]);
   free(game->tiles);
   for(unsigned int i = 0; i < game->size; i++)
     free(game->board[i]);
@@ -179,108 +661,224 @@ void print_solution (game *game) {
     }
 }
 
-int play (game *game, unsigned int x, unsigned int y, unsigned int required_color);
-int play_inversa (game *game, unsigned int x, unsigned int y, unsigned int required_color);
+// ---------------------------------------------------------------------------------------------
+// Fim de jogo: quando faltam no máximo g->endgame células, o resto vira um emparelhamento entre
+// as células abertas e as peças livres. Na entrada, cada par (célula, peça) guarda as rotações
+// que casam com a borda e com os vizinhos já colocados; dentro do fim de jogo só falta conferir
+// os vizinhos que também são do fim de jogo. A cada nível um emparelhamento bipartido (Kuhn,
+// sobre máscaras de bits) confirma que ainda existe uma peça distinta para cada célula antes de
+// descer, e a célula tentada é a que tem menos peças candidatas.
+// ---------------------------------------------------------------------------------------------
 
-// função play do professor modificada para seguir espiral na logica de fazer espiral ela ja define a cor que vai ser passada pro proximo, quee vai apenas olhar tiles que tem match de cor com valor recebido
-int play (game *game, unsigned int x, unsigned int y, unsigned int required_color) {
-  
-  tile_list *candidate_list = game->color_buckets[required_color];
-  
-  for (unsigned int i = 0; i < candidate_list->count; i++) {
-    tile *tile = candidate_list->tiles[i];
-    if (tile->used) continue;
-    
-    tile->used = 1;
-    for (int rot = 0; rot < 4; rot++) {
-      tile->rotation = rot;
-      if (valid_move(game, x, y, tile)) {
-        game->board[y][x] = tile;
-        unsigned int nx, ny;
-        unsigned int next_required_color = 0;
-        ny = nx = game->size;
-
-        if (x < game->size - 1 && game->board[y][x + 1] == NULL && (y == 0 || game->board[y - 1][x] != NULL)) {
-          nx = x + 1; ny = y;
-          next_required_color = E_COLOR(tile);
-        } else if (y < game->size - 1 && game->board[y + 1][x] == NULL) {
-          nx = x; ny = y + 1;
-          next_required_color = S_COLOR(tile);
-        } else if (x > 0 && game->board[y][x - 1] == NULL) {
-          nx = x - 1; ny = y;
-          next_required_color = W_COLOR(tile);
-        } else if (y > 0 && game->board[y - 1][x] == NULL) {
-          nx = x; ny = y - 1;
-          next_required_color = N_COLOR(tile);
-        } else {
-          ny = game->size;
-        }
+#define ENDGAME_DEFAULT 0  // desligado por padrão: nas medições nenhum -f ganhou de forma consistente
+#define ENDGAME_MAX 24     // limite de -f (as máscaras são de 32 bits)
+
+typedef struct {
+  const visit *cells[ENDGAME_MAX];
+  tile *tiles[ENDGAME_MAX];
+  unsigned int n;
+  unsigned char rotations[ENDGAME_MAX][ENDGAME_MAX]; // bit r: a peça cabe na célula com a rotação r
+  unsigned char inner[ENDGAME_MAX];                   // bit s: o vizinho do lado s é do fim de jogo
+  int next[ENDGAME_MAX][4];                           // índice desse vizinho no fim de jogo (-1 se não for)
+  unsigned int open, free_tiles;                      // máscaras das células abertas e das peças livres
+  int count_fails;                                    // ordem fails: conta as falhas das peças
+} endgame_state;
+
+// Rotações da peça t na célula c que casam com os vizinhos do fim de jogo já colocados
+unsigned int endgame_fit(const endgame_state *e, unsigned int c, unsigned int t) {
+  unsigned int fit = e->rotations[c][t];
+  const visit *v = e->cells[c];
+  for (int s = 0; s < 4 && fit; s++) {
+    if (!(e->inner[c] >> s & 1) || *v->neighbor[s] == NULL) continue;
+    unsigned int color = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+    for (unsigned int r = 0; r < 4; r++)
+      if (e->tiles[t]->colors[(s + 4 - r) % 4] != color) fit &= ~(1u << r);
+  }
+  return fit;
+}
+
+// Caminho aumentante de Kuhn a partir da célula c
+int endgame_augment(const unsigned int *cand, unsigned int c, unsigned int *seen, int *owner) {
+  for (unsigned int m = cand[c]; m; m &= m - 1) {
+    unsigned int t = __builtin_ctz(m);
+    if (*seen >> t & 1) continue;
+    *seen |= 1u << t;
+    if (owner[t] < 0 || endgame_augment(cand, owner[t], seen, owner)) {
+      owner[t] = c;
+      return 1;
+    }
+  }
+  return 0;
+}
+
+// cand[c] são as peças livres que cabem na célula c e fit[c][t] as rotações de cada uma. Ao
+// colocar uma peça só mudam as linhas dos vizinhos dela, que são refeitas na cópia do filho.
+int endgame_search(endgame_state *e, const unsigned int *cand, unsigned char (*fit)[ENDGAME_MAX]) {
+  if (e->open == 0) return 1;
+
+  int best = -1;
+  for (unsigned int m = e->open; m; m &= m - 1) {
+    unsigned int c = __builtin_ctz(m);
+    if (cand[c] == 0) return 0;
+    if (best < 0 || __builtin_popcount(cand[c]) < __builtin_popcount(cand[best])) best = c;
+  }
 
-        if (ny == game->size || play(game, nx, ny, next_required_color)) {
-          return 1;
+  // Sem emparelhamento perfeito nenhuma ordem de colocação resolve o resto
+  int owner[ENDGAME_MAX];
+  for (unsigned int t = 0; t < e->n; t++) owner[t] = -1;
+  for (unsigned int m = e->open; m; m &= m - 1) {
+    unsigned int seen = 0;
+    if (!endgame_augment(cand, __builtin_ctz(m), &seen, owner)) return 0;
+  }
+
+  const visit *v = e->cells[best];
+  unsigned int child_cand[ENDGAME_MAX];
+  unsigned char child_fit[ENDGAME_MAX][ENDGAME_MAX];
+  memcpy(child_fit, fit, e->n * sizeof(child_fit[0]));
+  e->open &= ~(1u << best);
+  for (unsigned int m = cand[best]; m; m &= m - 1) {
+    unsigned int t = __builtin_ctz(m);
+    tile *tile = e->tiles[t];
+    tile->used = 1;
+    *v->slot = tile;
+    e->free_tiles &= ~(1u << t);
+    for (unsigned int c = 0; c < e->n; c++) child_cand[c] = cand[c] & ~(1u << t);
+    for (unsigned int r = 0; r < 4; r++) {
+      if (!(fit[best][t] >> r & 1)) continue;
+      tile->rotation = r;
+      for (int s = 0; s < 4; s++) {
+        int c = e->next[best][s];
+        if (c < 0 || !(e->open >> c & 1)) continue;
+        child_cand[c] = 0;
+        for (unsigned int f = e->free_tiles; f; f &= f - 1) {
+          unsigned int u = __builtin_ctz(f);
+          child_fit[c][u] = endgame_fit(e, c, u);
+          if (child_fit[c][u]) child_cand[c] |= 1u << u;
         }
-        game->board[y][x] = NULL;
       }
+      if (endgame_search(e, child_cand, child_fit)) return 1;
     }
+    e->free_tiles |= 1u << t;
+    *v->slot = NULL;
     tile->used = 0;
+    if (e->count_fails) tile->fails++;
   }
-
+  e->open |= 1u << best;
   return 0;
 }
 
-// basicamente a mesma coisa que play mas espiral anti-horária.
-int play_inversa (game *game, unsigned int x, unsigned int y, unsigned int required_color) {
-  
-  tile_list *candidate_list = game->color_buckets[required_color];
-  
-  for (unsigned int i = 0; i < candidate_list->count; i++) {
-    tile *tile = candidate_list->tiles[i];
-    if (tile->used) continue;
-    
-    tile->used = 1;
-    for (int rot = 0; rot < 4; rot++) {
-      tile->rotation = rot;
-      if (valid_move(game, x, y, tile)) {
-        game->board[y][x] = tile;
-        unsigned int nx, ny;
-        unsigned int next_required_color = 0;
-        ny = nx = game->size;
-
-        if (y < game->size - 1 && game->board[y + 1][x] == NULL && (x == 0 || game->board[y][x - 1] != NULL)) {
-          nx = x; ny = y + 1;
-          next_required_color = S_COLOR(tile);
-        } else if (x < game->size - 1 && game->board[y][x + 1] == NULL) {
-          nx = x + 1; ny = y;
-          next_required_color = E_COLOR(tile);
-        } else if (y > 0 && game->board[y - 1][x] == NULL) {
-          nx = x; ny = y - 1;
-          next_required_color = N_COLOR(tile);
-        } else if (x > 0 && game->board[y][x - 1] == NULL) {
-          nx = x - 1; ny = y;
-          next_required_color = W_COLOR(tile);
-        } else {
-          ny = game->size;
-        }
+// Resolve as células order[0..n) com as peças ainda livres. Em caso de falha o tabuleiro volta
+// como estava.
+int solve_endgame(game *g, const visit *order, unsigned int n) {
+  endgame_state e;
+  e.n = n;
+  unsigned int k = 0;
+  for (unsigned int i = 0; i < g->tile_count; i++)
+    if (!g->tiles[i].used) e.tiles[k++] = &g->tiles[i];
+  assert(k == n);
 
-        if (ny == game->size || play_inversa(game, nx, ny, next_required_color)) {
-          return 1;
-        }
-        game->board[y][x] = NULL;
+  unsigned int cand[ENDGAME_MAX];
+  for (unsigned int c = 0; c < n; c++) {
+    const visit *v = &order[c];
+    e.cells[c] = v;
+    e.inner[c] = 0;
+    unsigned int req[4];
+    for (int s = 0; s < 4; s++) {
+      if (v->side[s] == SIDE_BORDER) req[s] = 0;
+      else if (*v->neighbor[s] != NULL) req[s] = X_COLOR((*v->neighbor[s]), (s + 2) % 4);
+      else {
+        req[s] = ANY_COLOR;
+        e.inner[c] |= 1 << s;
       }
     }
-    tile->used = 0;
+    cand[c] = 0;
+    for (unsigned int t = 0; t < n; t++) {
+      const unsigned int *colors = e.tiles[t]->colors;
+      e.rotations[c][t] = 0;
+      for (unsigned int r = 0; r < 4; r++) {
+        int ok = 1;
+        for (int s = 0; s < 4; s++)
+          ok &= (req[s] == ANY_COLOR) | (colors[(s + 4 - r) % 4] == req[s]);
+        e.rotations[c][t] |= ok << r;
+      }
+      if (e.rotations[c][t]) cand[c] |= 1u << t;
+    }
+    if (cand[c] == 0) return 0;
   }
+  // Quase sempre alguma célula já fica sem candidatas acima; só então vale ligar os vizinhos
+  for (unsigned int c = 0; c < n; c++)
+    for (int s = 0; s < 4; s++) {
+      e.next[c][s] = -1;
+      if (!(e.inner[c] >> s & 1)) continue;
+      for (unsigned int o = 0; o < n; o++)
+        if (order[o].slot == order[c].neighbor[s]) e.next[c][s] = o;
+    }
+  e.open = (1u << n) - 1;
+  e.free_tiles = e.open;
+  e.count_fails = g->ordering == ORDER_FAILS;
+  return endgame_search(&e, cand, e.rotations);
+}
+
+// ---------------------------------------------------------------------------------------------
+// Busca em espiral guiada pela tabela da ordem de visita, que já diz para cada célula quais
+// lados são borda, quais vizinhos já estão colocados e onde eles ficam no tabuleiro. Assim o
+// laço interno não testa limites nem procura a próxima célula.
+// ---------------------------------------------------------------------------------------------
 
+int play_table(game *g, const visit *order, unsigned int depth) {
+  const unsigned int cells = g->tile_count;
+  if (depth == cells) return 1;
+  if (nogood_lookup(g)) return 0;
+  if (cells - depth <= g->endgame) {
+    if (solve_endgame(g, order + depth, cells - depth)) return 1;
+    nogood_store(g);
+    return 0;
+  }
+
+  const visit *v = &order[depth];
+  unsigned int req[4];
+  tile_list *candidate_list = visit_requirements(g, v, req);
+  unsigned long long valid[candidate_list->count / 16 + 1];
+  filter_masked(candidate_list, req, valid);
+
+  for (unsigned int w = 0; w <= candidate_list->count / 16; w++) {
+    while (valid[w]) {
+      unsigned int k = w * 64 + __builtin_ctzll(valid[w]);
+      valid[w] &= valid[w] - 1;
+      tile *tile = candidate_list->tiles[k / 4];
+      if (tile->used) continue;
+
+      tile->used = 1;
+      tile->rotation = k % 4;
+      *v->slot = tile;
+      zobrist_toggle(g, v->x, v->y, tile);
+      if (play_table(g, order, depth + 1)) {
+        return 1;
+      }
+      zobrist_toggle(g, v->x, v->y, tile);
+      *v->slot = NULL;
+      tile->used = 0;
+      if (g->ordering == ORDER_FAILS) tile->fails++;
+    }
+  }
+
+  nogood_store(g);
   return 0;
 }
 
-// Tenta resolver o tabuleiro começando com uma peça de vértice específica escolhida 0 a 7, se for de 0 a 3 chama a função play, se for 4 a 7 chama play inversa. Logica que já ajuda na paralelização
+// Tenta resolver o tabuleiro começando com uma peça de vértice específica escolhida 0 a 7, se for de 0 a 3 segue a espiral normal, se for 4 a 7 a espiral inversa. Logica que já ajuda na paralelização
 // Começa sempre na posição (0,0).
 int play_first(game *g, int vertex_choice) {
     
     tile *start_tile;
     unsigned int x = 0, y = 0; // Posição inicial sempre (0,0)
 
+    // Canto fixado por uma dica: a busca começa direto na primeira célula livre da ordem
+    if (g->board[0][0] != NULL) {
+        if (vertex_choice % 4 != 0) return 0;
+        return play_table(g, g->spiral[vertex_choice >= 4], g->clues);
+    }
+
     // Lógica para chamar a busca normal ou a inversa
     if (vertex_choice >= 0 && vertex_choice <= 3) {
         if ((unsigned int)vertex_choice >= g->tiles_vertice->count) {
@@ -288,22 +886,23 @@ int play_first(game *g, int vertex_choice) {
             return 0;
         }
         start_tile = g->tiles_vertice->tiles[vertex_choice];
-        
-        unsigned int nx = 1, ny = 0; // Próxima posição para a espiral normal
+        if (start_tile->used) return 0; // peça fixada em outro canto por uma dica
 
         for (int rot = 0; rot < 4; rot++) {
             start_tile->rotation = rot;
             if (valid_move(g, x, y, start_tile)) {
                 g->board[y][x] = start_tile;
                 start_tile->used = 1;
+                zobrist_toggle(g, x, y, start_tile);
                 
-                unsigned int next_required_color = E_COLOR(start_tile);
-                if (play(g, nx, ny, next_required_color)) {
+                if (play_table(g, g->spiral[0], g->clues + 1)) {
                     return 1;
                 }
                 
+                zobrist_toggle(g, x, y, start_tile);
                 g->board[y][x] = NULL;
                 start_tile->used = 0;
+                reorder_buckets(g);
             }
         }
     } else if (vertex_choice >= 4 && vertex_choice <= 7) {
@@ -313,22 +912,23 @@ int play_first(game *g, int vertex_choice) {
             return 0;
         }
         start_tile = g->tiles_vertice->tiles[mapped_choice];
-
-        unsigned int nx = 0, ny = 1; // Próxima posição para a espiral inversa
+        if (start_tile->used) return 0;
 
         for (int rot = 0; rot < 4; rot++) {
             start_tile->rotation = rot;
             if (valid_move(g, x, y, start_tile)) {
                 g->board[y][x] = start_tile;
                 start_tile->used = 1;
+                zobrist_toggle(g, x, y, start_tile);
                 
-                unsigned int next_required_color = S_COLOR(start_tile);
-                if (play_inversa(g, nx, ny, next_required_color)) {
+                if (play_table(g, g->spiral[1], g->clues + 1)) {
                     return 1;
                 }
                 
+                zobrist_toggle(g, x, y, start_tile);
                 g->board[y][x] = NULL;
                 start_tile->used = 0;
+                reorder_buckets(g);
             }
         }
     } else {
@@ -339,15 +939,1226 @@ int play_first(game *g, int vertex_choice) {
     return 0; // Nenhuma rotação da peça inicial levou a uma solução
 }
 
+// ---------------------------------------------------------------------------------------------
+// Cobertura exata com Dancing Links: o algoritmo X de Knuth na versão com cores (algoritmo C).
+// Itens primários são as células e as peças, cobertos exatamente uma vez cada. Itens secundários
+// são as arestas internas: a primeira opção que toca uma aresta define a sua cor e as opções
+// com outra cor nela são escondidas. Cada opção é (célula, peça, rotação) compatível com a borda
+// e com as dicas. Sem dicas o canto (0,0) só aceita a primeira peça de vértice, como em
+// play_first(g, 0), então a contagem é de soluções distintas a menos de rotação do tabuleiro.
+// ---------------------------------------------------------------------------------------------
+
+typedef struct {
+  int *llink, *rlink;                 // Lista dos itens primários ainda não cobertos (cabeça 0)
+  int *top, *ulink, *dlink, *color;   // Nós; no cabeçalho de cada item, top é o tamanho da coluna
+  int *option;                        // Opção de cada nó
+  unsigned int *option_cell, *option_tile;
+  unsigned char *option_rot;
+  int *choice;                        // Nó escolhido em cada nível
+  unsigned int split_depth;           // Nível em que os ramos são divididos entre processos
+  long long branch;                   // Ramo desse nível a explorar (-1 só conta os ramos)
+  long long branch_counter;
+  int count_all;                      // Conta todas as soluções em vez de parar na primeira
+  unsigned long long solutions;
+} dlx;
+
+// Item da aresta interna do lado side da célula (x, y), ou 0 na borda
+unsigned int dlx_edge_item(game *g, unsigned int x, unsigned int y, int side) {
+  unsigned int base = 2 * g->tile_count + 1, n = g->size;
+  switch (side) {
+    case 0: return y == 0 ? 0 : base + V_EDGE(g, x, y - 1);
+    case 1: return x == n - 1 ? 0 : base + H_EDGE(g, x, y);
+    case 2: return y == n - 1 ? 0 : base + V_EDGE(g, x, y);
+    default: return x == 0 ? 0 : base + H_EDGE(g, x - 1, y);
+  }
+}
+
+// Se a peça t na rotação rot vira opção da célula (x, y)
+int dlx_allowed(game *g, unsigned int x, unsigned int y, tile *t, int rot) {
+  tile *fixed = g->board[y][x];
+  if (fixed != NULL) return fixed == t && fixed->rotation == rot;
+  if (t->used) return 0;
+  if (g->clues == 0 && x == 0 && y == 0 && g->size > 1 && g->tiles_vertice->count > 0 &&
+      t != g->tiles_vertice->tiles[0]) return 0;
+  t->rotation = rot;
+  return valid_move(g, x, y, t);
+}
+
+// Monta a matriz esparsa a partir do jogo já inicializado (com as dicas no tabuleiro)
+dlx *build_dlx(game *g, int count_all) {
+  unsigned int n = g->size, cells = g->tile_count;
+  unsigned int items = 2 * cells + 2 * n * (n - 1);
+  unsigned int options = 0, nodes = items + 2;
+
+  for (unsigned int c = 0; c < cells; c++)
+    for (unsigned int i = 0; i < g->tile_count; i++)
+      for (int rot = 0; rot < 4; rot++) {
+        if (!dlx_allowed(g, c % n, c / n, &g->tiles[i], rot)) continue;
+        options++;
+        nodes += 3;
+        for (int s = 0; s < 4; s++) nodes += dlx_edge_item(g, c % n, c / n, s) != 0;
+      }
+
+  dlx *d = calloc(1, sizeof(dlx));
+  assert(d != NULL);
+  d->llink = malloc((items + 1) * sizeof(int));
+  d->rlink = malloc((items + 1) * sizeof(int));
+  d->top = malloc(nodes * sizeof(int));
+  d->ulink = malloc(nodes * sizeof(int));
+  d->dlink = malloc(nodes * sizeof(int));
+  d->color = calloc(nodes, sizeof(int));
+  d->option = calloc(nodes, sizeof(int));
+  d->option_cell = malloc((options + 1) * sizeof(unsigned int));
+  d->option_tile = malloc((options + 1) * sizeof(unsigned int));
+  d->option_rot = malloc(options + 1);
+  d->choice = malloc((cells + 1) * sizeof(int));
+  assert(d->llink && d->rlink && d->top && d->ulink && d->dlink && d->color && d->option &&
+         d->option_cell && d->option_tile && d->option_rot && d->choice);
+  d->split_depth = cells + 1;
+  d->branch = -1;
+  d->count_all = count_all;
+
+  // Só os itens primários (1..2 * cells) entram na lista; os secundários apontam para si mesmos
+  for (unsigned int i = 0; i <= items; i++) {
+    d->llink[i] = (i == 0) ? (int)(2 * cells) : (i <= 2 * cells ? (int)i - 1 : (int)i);
+    d->rlink[i] = (i == 2 * cells) ? 0 : (i < 2 * cells ? (int)i + 1 : (int)i);
+    d->top[i] = 0;
+    d->ulink[i] = d->dlink[i] = i;
+  }
+
+  // Cada opção é seguida de um espaçador: ulink aponta para o primeiro nó da opção anterior e
+  // dlink para o último nó da próxima
+  int p = items + 1, spacer = p, o = 0;
+  d->top[p] = 0;
+  for (unsigned int c = 0; c < cells; c++)
+    for (unsigned int i = 0; i < g->tile_count; i++)
+      for (int rot = 0; rot < 4; rot++) {
+        tile *t = &g->tiles[i];
+        if (!dlx_allowed(g, c % n, c / n, t, rot)) continue;
+        int first = p + 1;
+        unsigned int row[6], colors[6], len = 0;
+        row[len] = 1 + c; colors[len++] = 0;
+        row[len] = 1 + cells + i; colors[len++] = 0;
+        t->rotation = rot;
+        for (int s = 0; s < 4; s++) {
+          unsigned int item = dlx_edge_item(g, c % n, c / n, s);
+          if (item) { row[len] = item; colors[len++] = X_COLOR(t, s) + 1; }
+        }
+        for (unsigned int k = 0; k < len; k++) {
+          p++;
+          d->top[p] = row[k];
+          d->color[p] = colors[k];
+          d->option[p] = o;
+          d->ulink[p] = d->ulink[row[k]];
+          d->dlink[p] = row[k];
+          d->dlink[d->ulink[row[k]]] = p;
+          d->ulink[row[k]] = p;
+          d->top[row[k]]++;
+        }
+        d->dlink[spacer] = p;
+        p++;
+        d->top[p] = -(o + 1);
+        d->ulink[p] = first;
+        spacer = p;
+        d->option_cell[o] = c;
+        d->option_tile[o] = i;
+        d->option_rot[o] = rot;
+        o++;
+      }
+  assert((unsigned int)p < nodes);
+  return d;
+}
+
+void free_dlx(dlx *d) {
+  free(d->llink); free(d->rlink);
+  free(d->top); free(d->ulink); free(d->dlink); free(d->color); free(d->option);
+  free(d->option_cell); free(d->option_tile); free(d->option_rot);
+  free(d->choice);
+  free(d);
+}
+
+// Tira da matriz as outras linhas da opção do nó p (hide' de Knuth)
+void dlx_hide(dlx *d, int p) {
+  for (int q = p + 1; q != p; ) {
+    int x = d->top[q], u = d->ulink[q], w = d->dlink[q];
+    if (x <= 0) q = u;
+    else {
+      if (d->color[q] >= 0) { d->dlink[u] = w; d->ulink[w] = u; d->top[x]--; }
+      q++;
+    }
+  }
+}
+
+void dlx_unhide(dlx *d, int p) {
+  for (int q = p - 1; q != p; ) {
+    int x = d->top[q], u = d->ulink[q], w = d->dlink[q];
+    if (x <= 0) q = w;
+    else {
+      if (d->color[q] >= 0) { d->dlink[u] = q; d->ulink[w] = q; d->top[x]++; }
+      q--;
+    }
+  }
+}
+
+void dlx_cover(dlx *d, int i) {
+  for (int p = d->dlink[i]; p != i; p = d->dlink[p]) dlx_hide(d, p);
+  d->rlink[d->llink[i]] = d->rlink[i];
+  d->llink[d->rlink[i]] = d->llink[i];
+}
+
+void dlx_uncover(dlx *d, int i) {
+  d->rlink[d->llink[i]] = i;
+  d->llink[d->rlink[i]] = i;
+  for (int p = d->ulink[i]; p != i; p = d->ulink[p]) dlx_unhide(d, p);
+}
+
+// Fixa a cor do item secundário do nó p: esconde as opções com outra cor e marca com -1 as de
+// mesma cor, que já não precisam ser escondidas de novo
+void dlx_purify(dlx *d, int p) {
+  int c = d->color[p], i = d->top[p];
+  for (int q = d->dlink[i]; q != i; q = d->dlink[q]) {
+    if (q == p) continue;
+    if (d->color[q] == c) d->color[q] = -1;
+    else dlx_hide(d, q);
+  }
+}
+
+void dlx_unpurify(dlx *d, int p) {
+  int c = d->color[p], i = d->top[p];
+  for (int q = d->ulink[i]; q != i; q = d->ulink[q]) {
+    if (q == p) continue;
+    if (d->color[q] < 0) d->color[q] = c;
+    else dlx_unhide(d, q);
+  }
+}
+
+void dlx_commit(dlx *d, int p, int j) {
+  if (d->color[p] == 0) dlx_cover(d, j);
+  else if (d->color[p] > 0) dlx_purify(d, p);
+}
+
+void dlx_uncommit(dlx *d, int p, int j) {
+  if (d->color[p] == 0) dlx_uncover(d, j);
+  else if (d->color[p] > 0) dlx_unpurify(d, p);
+}
+
+// Busca recursiva escolhendo sempre o item primário com menos opções. No nível split_depth
+// só o ramo de número branch é explorado. Retorna 1 ao achar uma solução (que fica no
+// tabuleiro); no modo count_all percorre tudo e soma em solutions.
+int dlx_search(dlx *d, game *g, unsigned int level) {
+  if (level == d->split_depth && d->branch_counter++ != d->branch) return 0;
+  if (d->rlink[0] == 0) {
+    if (d->count_all) {
+      d->solutions++;
+      return 0;
+    }
+    for (unsigned int l = 0; l < level; l++) {
+      int o = d->option[d->choice[l]];
+      tile *t = &g->tiles[d->option_tile[o]];
+      t->rotation = d->option_rot[o];
+      t->used = 1;
+      g->board[d->option_cell[o] / g->size][d->option_cell[o] % g->size] = t;
+    }
+    return 1;
+  }
+
+  int best = 0;
+  for (int i = d->rlink[0]; i != 0; i = d->rlink[i])
+    if (best == 0 || d->top[i] < d->top[best]) best = i;
+  if (d->top[best] == 0) return 0;
+
+  int found = 0;
+  dlx_cover(d, best);
+  for (int x = d->dlink[best]; x != best && !found; x = d->dlink[x]) {
+    for (int p = x + 1; p != x; ) {
+      int j = d->top[p];
+      if (j <= 0) p = d->ulink[p];
+      else { dlx_commit(d, p, j); p++; }
+    }
+    d->choice[level] = x;
+    found = dlx_search(d, g, level + 1);
+    for (int p = x - 1; p != x; ) {
+      int j = d->top[p];
+      if (j <= 0) p = d->dlink[p];
+      else { dlx_uncommit(d, p, j); p--; }
+    }
+  }
+  dlx_uncover(d, best);
+  return found;
+}
+
+// Relógio das sondas do modo automático, em segundos
+double probe_clock(void) {
+  return (double)clock() / CLOCKS_PER_SEC;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Modo automático (-s auto): perfila os buckets de cor, roda sondas curtas de cada configuração
+// candidata (heurística de ordenação x sentido da espiral x peça do canto) e dá o resto da busca
+// à que avançou mais rápido. O progresso de uma sonda é a fração da árvore já descartada pela
+// busca em profundidade: soma de (ramos terminados / ramos) em cada nível do caminho atual,
+// ponderada pelo produto de 1 / ramos dos níveis de cima. Progresso / tempo dá a taxa, e o
+// inverso da taxa é a previsão de tempo para percorrer a árvore toda.
+// ---------------------------------------------------------------------------------------------
+
+#define AUTO_PROBE_SECONDS 0.02 // Duração de cada sonda
+#define AUTO_SPREAD_MIN 0.5     // Abaixo disso as cores são uniformes e ORDER_RARE não muda nada
+#define AUTO_MAX_PROBES 24      // 3 ordenações x 8 tarefas de play_first
+
+static const char *ordering_names[] = {"id", "rare", "constraint", "fails"};
+
+typedef struct {
+  int ordering;
+  int vertex_choice;
+  unsigned long long nodes;
+  unsigned int max_depth;
+  double progress;
+  double seconds;
+  double rate; // progresso por segundo
+  int status;  // 0 sem resposta no prazo, 1 achou solução, 2 esgotou sem solução
+} auto_probe;
+
+typedef struct {
+  double deadline;
+  unsigned long long nodes;
+  unsigned int max_depth;
+  unsigned int stop_depth;      // nível em que o prazo estourou
+  int expired;
+  unsigned int *done, *width;   // ramos terminados e ramos válidos de cada nível do caminho
+} probe_state;
+
+// Perfil do quebra-cabeça a partir dos buckets de create_color_list: tamanhos e a dispersão
+// ((maior - menor) / média) da frequência das cores internas, que é retornada
+double profile_colors(game *g, int report) {
+  unsigned int min = g->tile_count * 4, max = 0, used = 0;
+  double sum = 0;
+  for (unsigned int c = 1; c < g->ncolors; c++) {
+    unsigned int count = g->color_buckets[c]->count;
+    if (count == 0) continue;
+    used++;
+    if (count < min) min = count;
+    if (count > max) max = count;
+    sum += count;
+  }
+  double mean = used ? sum / used : 0;
+  double spread = mean > 0 ? (max - min) / mean : 0;
+  if (report)
+    fprintf(stderr, "Perfil: %u cores internas, buckets de %u a %u peças (média %.1f, dispersão %.2f), "
+            "%u peças de borda, %u de vértice, %u dicas\n", used, used ? min : 0, max, mean, spread,
+            g->color_buckets[0]->count, g->tiles_vertice->count, g->clues);
+  return spread;
+}
+
+// Configurações candidatas. ORDER_FAILS fica de fora porque começa igual a ORDER_ID e só se
+// adapta entre subárvores da raiz, o que uma sonda curta não chega a ver.
+int auto_candidates(game *g, double spread, auto_probe *probes) {
+  int orderings[3] = {ORDER_ID, ORDER_CONSTRAINT, ORDER_RARE};
+  int norderings = spread >= AUTO_SPREAD_MIN ? 3 : 2, n = 0;
+  for (int o = 0; o < norderings; o++)
+    for (int v = 0; v < 8; v++) {
+      if (g->board[0][0] != NULL ? v % 4 != 0 : ((unsigned int)(v % 4) >= g->tiles_vertice->count ||
+                                                  g->tiles_vertice->tiles[v % 4]->used)) continue;
+      memset(&probes[n], 0, sizeof(auto_probe));
+      probes[n].ordering = orderings[o];
+      probes[n].vertex_choice = v;
+      n++;
+    }
+  return n;
+}
+
+// Mesma busca de play_table, sem hash nem nogoods, parando no prazo
+int probe_search(game *g, const visit *order, unsigned int depth, probe_state *pr) {
+  if (depth == g->tile_count) return 1;
+  if ((++pr->nodes & 1023) == 0 && probe_clock() > pr->deadline) pr->expired = 1;
+  if (pr->expired) {
+    pr->stop_depth = depth;
+    return 0;
+  }
+  if (depth > pr->max_depth) pr->max_depth = depth;
+
+  const visit *v = &order[depth];
+  unsigned int req[4];
+  tile_list *candidate_list = visit_requirements(g, v, req);
+  unsigned long long valid[candidate_list->count / 16 + 1];
+  filter_masked(candidate_list, req, valid);
+
+  pr->width[depth] = 0;
+  pr->done[depth] = 0;
+  for (unsigned int k = 0; k < candidate_list->count * 4; k++)
+    if ((valid[k / 64] >> (k % 64)) & 1 && !candidate_list->tiles[k / 4]->used) pr->width[depth]++;
+
+  for (unsigned int k = 0; k < candidate_list->count * 4; k++) {
+    tile *tile = candidate_list->tiles[k / 4];
+    if (!((valid[k / 64] >> (k % 64)) & 1) || tile->used) continue;
+    tile->used = 1;
+    tile->rotation = k % 4;
+    *v->slot = tile;
+    if (probe_search(g, order, depth + 1, pr)) return 1;
+    *v->slot = NULL;
+    tile->used = 0;
+    if (pr->expired) return 0;
+    pr->done[depth]++;
+  }
+  return 0;
+}
+
+// Fração da árvore descartada entre os níveis first e stop_depth do caminho da sonda
+double probe_progress(const probe_state *pr, unsigned int first) {
+  double progress = 0, weight = 1;
+  for (unsigned int d = first; d < pr->stop_depth && pr->width[d] > 0; d++) {
+    progress += weight * pr->done[d] / pr->width[d];
+    weight /= pr->width[d];
+  }
+  return progress;
+}
+
+// Roda uma sonda. Se ela achar a solução, o tabuleiro fica preenchido e retorna 1.
+int run_probe(game *g, auto_probe *p, double seconds) {
+  probe_state pr;
+  memset(&pr, 0, sizeof(pr));
+  pr.done = calloc(g->tile_count + 1, sizeof(unsigned int));
+  pr.width = calloc(g->tile_count + 1, sizeof(unsigned int));
+  assert(pr.done != NULL && pr.width != NULL);
+
+  g->ordering = p->ordering;
+  order_candidates(g);
+  const visit *order = g->spiral[p->vertex_choice >= 4];
+  double start = probe_clock();
+  pr.deadline = start + seconds;
+  int found = 0;
+
+  if (g->board[0][0] != NULL) {
+    found = probe_search(g, order, g->clues, &pr);
+    p->progress = pr.expired ? probe_progress(&pr, g->clues) : 1;
+  } else {
+    // A peça do canto é o primeiro nível: cada rotação válida é um ramo
+    tile *start_tile = g->tiles_vertice->tiles[p->vertex_choice % 4];
+    unsigned int rotations = 0, finished = 0;
+    for (int rot = 0; rot < 4; rot++) {
+      start_tile->rotation = rot;
+      rotations += valid_move(g, 0, 0, start_tile);
+    }
+    for (int rot = 0; rot < 4 && !found && !pr.expired; rot++) {
+      start_tile->rotation = rot;
+      if (!valid_move(g, 0, 0, start_tile)) continue;
+      start_tile->used = 1;
+      g->board[0][0] = start_tile;
+      found = probe_search(g, order, g->clues + 1, &pr);
+      if (found) break;
+      g->board[0][0] = NULL;
+      start_tile->used = 0;
+      if (!pr.expired) finished++;
+    }
+    double inner = pr.expired ? probe_progress(&pr, g->clues + 1) : 0;
+    p->progress = rotations ? (finished + inner) / rotations : 1;
+  }
+
+  p->seconds = probe_clock() - start;
+  p->nodes = pr.nodes;
+  p->max_depth = pr.max_depth;
+  p->status = found ? 1 : (pr.expired ? 0 : 2);
+  p->rate = p->progress / (p->seconds > 1e-9 ? p->seconds : 1e-9);
+  free(pr.done);
+  free(pr.width);
+  return found;
+}
+
+void report_probe(const auto_probe *p) {
+  static const char *status[] = {"no prazo", "achou solução", "esgotou"};
+  fprintf(stderr, "Sonda: ordem %s, %s, canto %d: %llu nós, profundidade %u, progresso %.3e em %.3f s "
+          "(%.3e/s, %s)\n", ordering_names[p->ordering], p->vertex_choice >= 4 ? "inversa" : "espiral",
+          p->vertex_choice % 4, p->nodes, p->max_depth, p->progress, p->seconds, p->rate, status[p->status]);
+}
+
+// Cantos (bit c = peça de vértice c) cuja árvore alguma sonda percorreu inteira sem solução.
+// A sonda não usa nogoods, então o canto não tem solução em nenhum sentido nem ordenação.
+unsigned int auto_exhausted(const auto_probe *probes, int n) {
+  unsigned int exhausted = 0;
+  for (int i = 0; i < n; i++)
+    if (probes[i].status == 2) exhausted |= 1u << (probes[i].vertex_choice % 4);
+  return exhausted;
+}
+
+// Sem dicas cada canto é a busca inteira (girar uma solução leva qualquer peça de vértice ao
+// (0,0)), assim como com o canto fixado por uma dica; com dicas e o canto livre, todos os cantos
+// possíveis precisam ter esgotado para provar que não há solução.
+int auto_unsolvable(game *g, unsigned int exhausted) {
+  if (exhausted && (g->clues == 0 || g->board[0][0] != NULL)) return 1;
+  if (g->board[0][0] != NULL) return 0;
+  for (unsigned int c = 0; c < 4 && c < g->tiles_vertice->count; c++)
+    if (!g->tiles_vertice->tiles[c]->used && !(exhausted >> c & 1)) return 0;
+  return 1;
+}
+
+// Escolhe a sonda vencedora: uma que achou solução, senão a de maior taxa de progresso entre as
+// que não esgotaram (rodar de novo uma árvore já esgotada não acharia nada)
+int auto_winner(const auto_probe *probes, int n) {
+  int best = -1;
+  for (int i = 0; i < n; i++) {
+    if (best >= 0 && probes[best].status == 1) break;
+    if (probes[i].status == 2) continue;
+    if (best < 0 || probes[i].status == 1 || probes[i].rate > probes[best].rate) best = i;
+  }
+  if (best < 0) return -1;
+  const auto_probe *p = &probes[best];
+  fprintf(stderr, "Escolha: ordem %s, %s, canto %d entre %d configurações", ordering_names[p->ordering],
+          p->vertex_choice >= 4 ? "inversa" : "espiral", p->vertex_choice % 4, n);
+  if (p->rate > 0) fprintf(stderr, " (ETA %.3f s pela taxa)\n", 1 / p->rate);
+  else fprintf(stderr, " (sem progresso medido)\n");
+  return best;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Estimativa do tamanho da árvore de busca (método de Knuth): cada amostra desce por um caminho
+// aleatório seguindo a ordem de visita da espiral e soma os produtos do número de filhos
+// válidos em cada nível. A média das amostras é um estimador sem viés do número de nós.
+// ---------------------------------------------------------------------------------------------
+
+// Estima os nós da subárvore a partir do estado atual, com as depth primeiras células de order
+// já colocadas. nodes recebe quantos nós as amostras expandiram, para medir o custo por nó.
+double estimate_subtree(game *g, const visit *order, unsigned int depth, unsigned int probes,
+                        unsigned long long *seed, unsigned long long *nodes) {
+  double total = 0;
+  tile **path = malloc(g->tile_count * sizeof(tile*));
+  unsigned int *choices = malloc(g->tile_count * 4 * sizeof(unsigned int));
+  assert(path != NULL && choices != NULL);
+
+  for (unsigned int p = 0; p < probes; p++) {
+    double estimate = 1, width = 1;
+    unsigned int d = depth;
+    while (d < g->tile_count) {
+      const visit *v = &order[d];
+      tile_list *candidate_list = g->color_buckets[visit_color(g, v)];
+      unsigned long long valid[candidate_list->count / 16 + 1];
+      unsigned int n = 0;
+      filter_candidates(g, candidate_list, v->x, v->y, valid);
+      for (unsigned int k = 0; k < candidate_list->count * 4; k++)
+        if ((valid[k / 64] >> (k % 64)) & 1 && !candidate_list->tiles[k / 4]->used) choices[n++] = k;
+      (*nodes)++;
+      if (n == 0) break;
+
+      width *= n;
+      estimate += width;
+      unsigned int k = choices[splitmix64(seed) % n];
+      tile *t = candidate_list->tiles[k / 4];
+      t->rotation = k % 4;
+      t->used = 1;
+      g->board[v->y][v->x] = t;
+      path[d++] = t;
+    }
+    while (d > depth) {
+      d--;
+      path[d]->used = 0;
+      g->board[order[d].y][order[d].x] = NULL;
+    }
+    total += estimate;
+  }
+
+  free(path);
+  free(choices);
+  return probes ? total / probes : 0;
+}
+
+// Estima os nós de play_first(g, vertex_choice), somando as rotações válidas da peça inicial
+double estimate_task(game *g, int vertex_choice, unsigned int probes, unsigned long long *seed,
+                     unsigned long long *nodes) {
+  const visit *order = g->spiral[vertex_choice >= 4];
+  if (g->board[0][0] != NULL)
+    return vertex_choice % 4 ? 0 : estimate_subtree(g, order, g->clues, probes, seed, nodes);
+  if ((unsigned int)(vertex_choice % 4) >= g->tiles_vertice->count) return 0;
+  tile *start_tile = g->tiles_vertice->tiles[vertex_choice % 4];
+  if (start_tile->used) return 0;
+  double estimate = 0;
+
+  start_tile->used = 1;
+  for (int rot = 0; rot < 4; rot++) {
+    start_tile->rotation = rot;
+    if (!valid_move(g, 0, 0, start_tile)) continue;
+    g->board[0][0] = start_tile;
+    estimate += estimate_subtree(g, order, g->clues + 1, probes, seed, nodes);
+    g->board[0][0] = NULL;
+  }
+  start_tile->used = 0;
+  return estimate;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Meet-in-the-middle: enumera todas as metades de cima válidas e guarda numa tabela hash
+// indexada pelas cores do lado sul da linha do meio, junto com o bitset das peças usadas.
+// Depois enumera as metades de baixo e procura a metade de cima com as mesmas cores no meio e
+// exatamente as peças que sobraram. As duas metades são preenchidas linha a linha.
+// A metade de cima é a guardada porque a quebra de simetria do canto (0,0) a deixa menor, e
+// a de baixo começa justamente pela linha do meio, onde a tabela já consegue podar:
+// - cada prefixo das cores do norte da linha do meio precisa existir em alguma metade de cima;
+// - com a linha do meio completa, as próximas linhas só podem usar peças que faltam em
+//   alguma metade de cima compatível (mascara allowed).
+// As duas enumerações são exaustivas, então em tabuleiros com muitas soluções a espiral acha a
+// primeira bem antes. Por isso uma estimativa de Knuth da metade de cima roda antes: se ela
+// prevê uma tabela maior que -b ou mais nós que MITM_NODE_BUDGET, o solver desiste na hora, e
+// as duas enumerações param ao passar do orçamento de nós.
+// ---------------------------------------------------------------------------------------------
+
+#define MITM_NODE_BUDGET (1ULL << 20) // nós das duas metades antes de voltar para a espiral
+#define MITM_PROBES 256                // amostras da estimativa da metade de cima
+
+typedef struct {
+  unsigned int half;           // linhas da metade de cima (as demais são da metade de baixo)
+  unsigned int words;          // palavras de 64 bits do bitset de peças
+  unsigned int cells;          // células da metade de cima
+  size_t entry_size;           // bytes por entrada: bitset, cores do meio e células (id * 4 + rotação)
+  unsigned char *entries;
+  unsigned long long *hashes;  // hash completo (cores + bitset) de cada entrada
+  unsigned int *next;          // encadeamento das entradas com as mesmas cores no meio
+  unsigned int *heads;         // primeiro elemento de cada bucket (MITM_EMPTY se vazio)
+  unsigned int count, capacity;
+  size_t limit;                // memória máxima das entradas, em bytes
+  unsigned long long bucket_mask;
+  unsigned long long *bloom;   // filtro com os prefixos das cores do meio
+  unsigned long long bloom_mask;
+  unsigned long long *bits;    // bitset de trabalho
+  unsigned long long *allowed; // peças permitidas abaixo da linha do meio
+  unsigned char *colors;       // cores do meio de trabalho
+  unsigned long long nodes;    // nós visitados, para o orçamento MITM_NODE_BUDGET
+} mitm_table;
+
+#define MITM_EMPTY 0xFFFFFFFFu
+
+unsigned long long mitm_mix(unsigned long long h, unsigned long long v) {
+  h ^= v + 0x9E3779B97F4A7C15ULL + (h << 6) + (h >> 2);
+  return splitmix64(&h);
+}
+
+// O hash das cores é o último prefixo do filtro; o hash completo continua sobre o bitset
+unsigned long long mitm_color_hash(const unsigned char *colors, unsigned int size) {
+  unsigned long long h = 0;
+  for (unsigned int i = 0; i < size; i++) h = mitm_mix(h, colors[i]);
+  return h;
+}
+
+unsigned long long mitm_full_hash(unsigned long long h, const unsigned long long *bits, unsigned int words) {
+  for (unsigned int i = 0; i < words; i++) h = mitm_mix(h, bits[i]);
+  return h;
+}
+
+void mitm_bloom_set(mitm_table *m, unsigned long long h) {
+  m->bloom[(h >> 6) & m->bloom_mask] |= 1ULL << (h & 63);
+}
+
+int mitm_bloom_test(mitm_table *m, unsigned long long h) {
+  return (m->bloom[(h >> 6) & m->bloom_mask] >> (h & 63)) & 1;
+}
+
+// Lê as cores do meio e o bitset das peças das linhas [y0, y1). Na folha da metade de baixo o
+// bitset é complementado, assim a busca na tabela é uma comparação exata com a metade de cima.
+void mitm_signature(mitm_table *m, game *g, int top, unsigned int y0, unsigned int y1, int complement) {
+  memset(m->bits, 0, m->words * sizeof(unsigned long long));
+  for (unsigned int j = y0; j < y1; j++)
+    for (unsigned int i = 0; i < g->size; i++) {
+      unsigned int id = g->board[j][i]->id;
+      m->bits[id / 64] |= 1ULL << (id % 64);
+    }
+  for (unsigned int i = 0; i < g->size; i++)
+    m->colors[i] = top ? S_COLOR(g->board[m->half - 1][i]) : N_COLOR(g->board[m->half][i]);
+  if (complement) {
+    for (unsigned int i = 0; i < m->words; i++) m->bits[i] = ~m->bits[i];
+    if (g->tile_count % 64) m->bits[m->words - 1] &= (1ULL << (g->tile_count % 64)) - 1;
+  }
+}
+
+// Folha da metade de cima: guarda a entrada. Retorna -1 se estourar o limite de memória.
+int mitm_store_top(game *g, mitm_table *m) {
+  if (m->count == m->capacity) {
+    unsigned int capacity = m->capacity ? m->capacity * 2 : 1024;
+    if ((size_t)capacity * m->entry_size > m->limit) {
+      capacity = (unsigned int)(m->limit / m->entry_size);
+      if (capacity <= m->count) return -1;
+    }
+    m->entries = realloc(m->entries, (size_t)capacity * m->entry_size);
+    m->hashes = realloc(m->hashes, (size_t)capacity * sizeof(unsigned long long));
+    assert(m->entries != NULL && m->hashes != NULL);
+    m->capacity = capacity;
+  }
+  mitm_signature(m, g, 1, 0, m->half, 0);
+  unsigned char *e = m->entries + (size_t)m->count * m->entry_size;
+  memcpy(e, m->bits, m->words * sizeof(unsigned long long));
+  e += m->words * sizeof(unsigned long long);
+  memcpy(e, m->colors, g->size);
+  unsigned short *cell = (unsigned short *)(e + g->size + (g->size & 1));
+  for (unsigned int j = 0; j < m->half; j++)
+    for (unsigned int i = 0; i < g->size; i++) {
+      tile *t = g->board[j][i];
+      *cell++ = (unsigned short)(t->id * 4 + t->rotation);
+    }
+  m->hashes[m->count] = mitm_full_hash(mitm_color_hash(m->colors, g->size), m->bits, m->words);
+  m->count++;
+  return 0;
+}
+
+// Linha do meio completa: calcula as peças que ainda podem ser usadas na metade de baixo.
+// Retorna 0 se nenhuma metade de cima com essas cores é disjunta da linha do meio.
+int mitm_middle_row(game *g, mitm_table *m, unsigned long long color_hash) {
+  int any = 0;
+  mitm_signature(m, g, 0, m->half, m->half + 1, 0);
+  memset(m->allowed, 0, m->words * sizeof(unsigned long long));
+  for (unsigned int k = m->heads[color_hash & m->bucket_mask]; k != MITM_EMPTY; k = m->next[k]) {
+    unsigned long long *top_bits = (unsigned long long *)(m->entries + (size_t)k * m->entry_size);
+    if (memcmp(top_bits + m->words, m->colors, g->size) != 0) continue;
+    int disjoint = 1;
+    for (unsigned int i = 0; i < m->words && disjoint; i++)
+      if (top_bits[i] & m->bits[i]) disjoint = 0;
+    if (!disjoint) continue;
+    for (unsigned int i = 0; i < m->words; i++) m->allowed[i] |= ~top_bits[i];
+    any = 1;
+  }
+  return any;
+}
+
+// Folha da metade de baixo: procura a metade de cima complementar e, se achar, completa o tabuleiro
+int mitm_probe_bottom(game *g, mitm_table *m) {
+  mitm_signature(m, g, 0, m->half, g->size, 1);
+  unsigned long long color_hash = mitm_color_hash(m->colors, g->size);
+  unsigned long long h = mitm_full_hash(color_hash, m->bits, m->words);
+  for (unsigned int k = m->heads[color_hash & m->bucket_mask]; k != MITM_EMPTY; k = m->next[k]) {
+    if (m->hashes[k] != h) continue;
+    unsigned char *e = m->entries + (size_t)k * m->entry_size;
+    if (memcmp(e, m->bits, m->words * sizeof(unsigned long long)) != 0) continue;
+    e += m->words * sizeof(unsigned long long);
+    if (memcmp(e, m->colors, g->size) != 0) continue;
+    unsigned short *cell = (unsigned short *)(e + g->size + (g->size & 1));
+    for (unsigned int j = 0; j < m->half; j++)
+      for (unsigned int i = 0; i < g->size; i++) {
+        tile *t = &g->tiles[*cell / 4];
+        t->rotation = *cell % 4;
+        g->board[j][i] = t;
+        cell++;
+      }
+    return 1;
+  }
+  return 0;
+}
+
+// Preenche as linhas [y, y_end) em varredura linha a linha e chama leaf em cada metade completa
+int mitm_fill(game *g, mitm_table *m, unsigned int x, unsigned int y, unsigned int y_end, int top,
+              unsigned long long prefix, int (*leaf)(game *, mitm_table *)) {
+  if (y == y_end) return leaf(g, m);
+  if (++m->nodes > MITM_NODE_BUDGET) return -2;
+
+  unsigned int required_color = (x > 0) ? E_COLOR(g->board[y][x - 1]) : 0;
+  tile_list *candidate_list = g->color_buckets[required_color];
+  unsigned int nx = (x + 1 < g->size) ? x + 1 : 0;
+  unsigned int ny = (nx == 0) ? y + 1 : y;
+
+  for (unsigned int i = 0; i < candidate_list->count; i++) {
+    tile *tile = candidate_list->tiles[i];
+    if (tile->used) continue;
+    // Quebra de simetria: a primeira peça de vértice sempre fica no canto (0,0), como em play_first
+    if (top && x == 0 && y == 0 && tile != g->tiles_vertice->tiles[0]) continue;
+    if (!top && y > m->half && !((m->allowed[tile->id / 64] >> (tile->id % 64)) & 1)) continue;
+
+    tile->used = 1;
+    for (int rot = 0; rot < 4; rot++) {
+      tile->rotation = rot;
+      if (!valid_move(g, x, y, tile)) continue;
+      unsigned long long next_prefix = prefix;
+      g->board[y][x] = tile;
+      if (!top && y == m->half) {
+        next_prefix = mitm_mix(prefix, N_COLOR(tile));
+        if (!mitm_bloom_test(m, next_prefix) || (nx == 0 && !mitm_middle_row(g, m, next_prefix))) {
+          g->board[y][x] = NULL;
+          continue;
+        }
+      }
+      int r = mitm_fill(g, m, nx, ny, y_end, top, next_prefix, leaf);
+      if (r != 0) {
+        tile->used = (r > 0);
+        if (r < 0) g->board[y][x] = NULL;
+        return r;
+      }
+      g->board[y][x] = NULL;
+    }
+    tile->used = 0;
+  }
+  return 0;
+}
+
+// Estimativa de Knuth da enumeração da metade de cima, na mesma ordem linha a linha de
+// mitm_fill. Retorna os nós previstos e guarda em leaves as metades completas previstas.
+double mitm_estimate(game *g, unsigned int half, double *leaves) {
+  unsigned long long seed = 0x5EED; // fixa: na versão MPI todos os trabalhadores decidem igual
+  unsigned int cells = half * g->size;
+  tile **path = malloc(cells * sizeof(tile*));
+  unsigned int *choices = malloc(g->tile_count * 4 * sizeof(unsigned int));
+  assert(path != NULL && choices != NULL);
+  double nodes = 0;
+  *leaves = 0;
+
+  for (unsigned int p = 0; p < MITM_PROBES; p++) {
+    double width = 1;
+    unsigned int d = 0;
+    nodes += 1;
+    while (d < cells) {
+      unsigned int x = d % g->size, y = d / g->size;
+      tile_list *candidate_list = g->color_buckets[x > 0 ? E_COLOR(g->board[y][x - 1]) : 0];
+      unsigned int n = 0;
+      for (unsigned int i = 0; i < candidate_list->count; i++) {
+        tile *t = candidate_list->tiles[i];
+        if (t->used || (d == 0 && t != g->tiles_vertice->tiles[0])) continue;
+        for (unsigned int rot = 0; rot < 4; rot++) {
+          t->rotation = rot;
+          if (valid_move(g, x, y, t)) choices[n++] = i * 4 + rot;
+        }
+      }
+      if (n == 0) break;
+      width *= n;
+      nodes += width;
+      unsigned int k = choices[splitmix64(&seed) % n];
+      tile *t = candidate_list->tiles[k / 4];
+      t->rotation = k % 4;
+      t->used = 1;
+      g->board[y][x] = t;
+      path[d++] = t;
+    }
+    if (d == cells) *leaves += width;
+    while (d > 0) {
+      d--;
+      path[d]->used = 0;
+      g->board[d / g->size][d % g->size] = NULL;
+    }
+  }
+
+  free(path);
+  free(choices);
+  *leaves /= MITM_PROBES;
+  return nodes / MITM_PROBES;
+}
+
+// Retorna 1 se achou solução, 0 se não existe, -1 se a tabela passou (ou passaria, pela
+// estimativa) de limit_mb megabytes e -2 se a busca passou (ou passaria) de MITM_NODE_BUDGET nós
+int solve_mitm(game *g, unsigned int limit_mb) {
+  if (g->size < 2 || g->tiles_vertice->count == 0) return 0;
+
+  mitm_table m;
+  memset(&m, 0, sizeof(m));
+  m.half = g->size / 2;
+  m.words = (g->tile_count + 63) / 64;
+  m.cells = m.half * g->size;
+  m.entry_size = m.words * sizeof(unsigned long long) + g->size + (g->size & 1) + m.cells * sizeof(unsigned short);
+  m.entry_size = (m.entry_size + 7) & ~(size_t)7;
+  m.limit = (size_t)limit_mb << 20;
+
+  double leaves, nodes = mitm_estimate(g, m.half, &leaves);
+  if (leaves * m.entry_size > m.limit) return -1;
+  if (nodes > MITM_NODE_BUDGET) return -2;
+
+  m.bits = malloc(m.words * sizeof(unsigned long long));
+  m.allowed = malloc(m.words * sizeof(unsigned long long));
+  m.colors = malloc(g->size);
+  assert(m.bits != NULL && m.allowed != NULL && m.colors != NULL);
+
+  int result = mitm_fill(g, &m, 0, 0, m.half, 1, 0, mitm_store_top);
+
+  if (result == 0 && m.count > 0) {
+    // Tabela hash com encadeamento e filtro de prefixos, ambos com potência de 2 posições
+    unsigned long long buckets = 1;
+    while (buckets < m.count) buckets *= 2;
+    m.bucket_mask = buckets - 1;
+    m.heads = malloc(buckets * sizeof(unsigned int));
+    m.next = malloc((size_t)m.count * sizeof(unsigned int));
+    unsigned long long bloom_words = 1;
+    while (bloom_words * 64 < (unsigned long long)m.count * g->size * 8) bloom_words *= 2;
+    m.bloom = calloc(bloom_words, sizeof(unsigned long long));
+    m.bloom_mask = bloom_words - 1;
+    assert(m.heads != NULL && m.next != NULL && m.bloom != NULL);
+    memset(m.heads, 0xFF, buckets * sizeof(unsigned int));
+
+    for (unsigned int k = 0; k < m.count; k++) {
+      unsigned char *colors = m.entries + (size_t)k * m.entry_size + m.words * sizeof(unsigned long long);
+      unsigned long long prefix = 0;
+      for (unsigned int i = 0; i < g->size; i++) {
+        prefix = mitm_mix(prefix, colors[i]);
+        mitm_bloom_set(&m, prefix);
+      }
+      m.next[k] = m.heads[prefix & m.bucket_mask];
+      m.heads[prefix & m.bucket_mask] = k;
+    }
+
+    result = mitm_fill(g, &m, 0, m.half, g->size, 0, 0, mitm_probe_bottom);
+  }
+
+  free(m.entries);
+  free(m.hashes);
+  free(m.next);
+  free(m.heads);
+  free(m.bloom);
+  free(m.bits);
+  free(m.allowed);
+  free(m.colors);
+  return result;
+}
+
+// ---------------------------------------------------------------------------------------------
+// Macro-peças 2x2 (-s macro): enumera todos os blocos 2x2 de peças distintas que casam por
+// dentro e busca num tabuleiro com metade do lado, linha a linha, um bloco por célula. Cada
+// classe de posição (quais lados do bloco são borda) tem o seu índice dos blocos válidos nela,
+// ordenado pela assinatura (cores do norte e do oeste), e os candidatos de cada célula saem de
+// uma busca binária nesse índice. As peças já usadas ficam num bitset. Só para lado par e sem
+// dicas; o bloco do canto (0,0) começa pela primeira peça de vértice, como play_first(g, 0).
+// ---------------------------------------------------------------------------------------------
+
+// Cor do lado side da peça id na rotação rot, sem mexer na rotação guardada na peça
+#define ROT_COLOR(g, id, rot, side) ((g)->tiles[id].colors[((side) + 4 - (rot)) % 4])
+
+// Bloco 2x2 compacto: peças NW, NE, SW, SE e as 4 rotações, 2 bits cada (10 bytes)
+typedef struct {
+  unsigned short tile[4];
+  unsigned char rot;
+} macro_block;
+
+typedef struct {
+  unsigned long long key; // cores N e W do bloco (8 bits cada)
+  unsigned int block;
+} macro_entry;
+
+typedef struct {
+  macro_block *blocks;
+  unsigned int count, capacity;
+  size_t limit;                  // bytes permitidos para os blocos e os índices
+  macro_entry *entries[16];      // blocos válidos em cada classe (máscara dos lados de borda)
+  unsigned int entry_count[16];
+  unsigned int half;             // lado do tabuleiro de macro-peças
+  unsigned int words;
+  unsigned long long *used;      // bitset das peças usadas
+  unsigned int *choice;          // bloco escolhido em cada célula do tabuleiro de macro-peças
+} macro_table;
+
+// Cores do lado side do bloco (0 N, 1 E, 2 S, 3 W), de oeste para leste ou de norte para sul
+void macro_side(game *g, const macro_block *b, int side, unsigned int *c) {
+  static const int first[4] = {0, 1, 2, 0}, second[4] = {1, 3, 3, 2};
+  c[0] = ROT_COLOR(g, b->tile[first[side]], (b->rot >> (2 * first[side])) & 3, side);
+  c[1] = ROT_COLOR(g, b->tile[second[side]], (b->rot >> (2 * second[side])) & 3, side);
+}
+
+unsigned long long macro_key(const unsigned int *n, const unsigned int *w) {
+  return ((unsigned long long)n[0] << 24) | (n[1] << 16) | (w[0] << 8) | w[1];
+}
+
+// Lados de borda da célula (x, y) do tabuleiro de macro-peças: bit s para o lado s
+unsigned int macro_mask(unsigned int half, unsigned int x, unsigned int y) {
+  return (y == 0) | (x == half - 1) << 1 | (y == half - 1) << 2 | (x == 0) << 3;
+}
+
+int macro_push(macro_table *t, const unsigned int *id, const unsigned int *rot) {
+  if (t->count >= t->capacity) {
+    t->capacity = t->capacity ? t->capacity * 2 : 1024;
+    if ((size_t)t->capacity * sizeof(macro_block) > t->limit) return -1;
+    t->blocks = realloc(t->blocks, (size_t)t->capacity * sizeof(macro_block));
+    assert(t->blocks != NULL);
+  }
+  macro_block *b = &t->blocks[t->count++];
+  b->rot = 0;
+  for (int k = 0; k < 4; k++) {
+    b->tile[k] = (unsigned short)id[k];
+    b->rot |= rot[k] << (2 * k);
+  }
+  return 0;
+}
+
+// Enumera os blocos cuja peça NW é a peça a. Retorna -1 se a tabela passar do limite.
+int macro_enumerate(game *g, macro_table *t, unsigned int a) {
+  unsigned int id[4], rot[4];
+  id[0] = a;
+  for (rot[0] = 0; rot[0] < 4; rot[0]++) {
+    unsigned int east = ROT_COLOR(g, a, rot[0], 1), south = ROT_COLOR(g, a, rot[0], 2);
+    if (east >= g->ncolors || south >= g->ncolors) continue;
+    tile_list *ne = g->color_buckets[east], *sw = g->color_buckets[south];
+    for (unsigned int i = 0; i < ne->count; i++) {
+      id[1] = ne->tiles[i]->id;
+      if (id[1] == a) continue;
+      for (rot[1] = 0; rot[1] < 4; rot[1]++) {
+        if (ROT_COLOR(g, id[1], rot[1], 3) != east) continue;
+        unsigned int need_north = ROT_COLOR(g, id[1], rot[1], 2);
+        if (need_north >= g->ncolors) continue;
+        tile_list *se = g->color_buckets[need_north];
+        for (unsigned int j = 0; j < sw->count; j++) {
+          id[2] = sw->tiles[j]->id;
+          if (id[2] == a || id[2] == id[1]) continue;
+          for (rot[2] = 0; rot[2] < 4; rot[2]++) {
+            if (ROT_COLOR(g, id[2], rot[2], 0) != south) continue;
+            unsigned int need_west = ROT_COLOR(g, id[2], rot[2], 1);
+            for (unsigned int k = 0; k < se->count; k++) {
+              id[3] = se->tiles[k]->id;
+              if (id[3] == a || id[3] == id[1] || id[3] == id[2]) continue;
+              for (rot[3] = 0; rot[3] < 4; rot[3]++) {
+                if (ROT_COLOR(g, id[3], rot[3], 0) != need_north || ROT_COLOR(g, id[3], rot[3], 3) != need_west) continue;
+                if (macro_push(t, id, rot) < 0) return -1;
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+int compare_macro_entries(const void *a, const void *b) {
+  const macro_entry *ea = a, *eb = b;
+  if (ea->key != eb->key) return ea->key < eb->key ? -1 : 1;
+  return (ea->block > eb->block) - (ea->block < eb->block);
+}
+
+// Monta o índice de cada classe de posição que aparece no tabuleiro. Retorna -1 se passar
+// do limite de memória.
+int macro_index(game *g, macro_table *t) {
+  size_t bytes = (size_t)t->count * sizeof(macro_block);
+  for (unsigned int mask = 0; mask < 16; mask++) {
+    int present = 0;
+    for (unsigned int c = 0; c < t->half * t->half && !present; c++)
+      present = macro_mask(t->half, c % t->half, c / t->half) == mask;
+    if (!present) continue;
+    // A classe do canto (0,0) só existe nessa célula: ali fica a quebra de simetria
+    int corner = (mask == macro_mask(t->half, 0, 0));
+
+    unsigned int n = 0;
+    for (int pass = 0; pass < 2; pass++) {
+      n = 0;
+      for (unsigned int i = 0; i < t->count; i++) {
+        const macro_block *b = &t->blocks[i];
+        int ok = !corner || b->tile[0] == g->tiles_vertice->tiles[0]->id;
+        for (int s = 0; s < 4 && ok; s++) {
+          if (!(mask >> s & 1)) continue;
+          unsigned int c[2];
+          macro_side(g, b, s, c);
+          ok = c[0] == 0 && c[1] == 0;
+        }
+        if (!ok) continue;
+        if (pass == 1) {
+          unsigned int nc[2], wc[2];
+          macro_side(g, b, 0, nc);
+          macro_side(g, b, 3, wc);
+          t->entries[mask][n].key = macro_key(nc, wc);
+          t->entries[mask][n].block = i;
+        }
+        n++;
+      }
+      if (pass == 0) {
+        bytes += (size_t)n * sizeof(macro_entry);
+        if (bytes > t->limit) return -1;
+        t->entries[mask] = malloc((size_t)n * sizeof(macro_entry) + 1);
+        assert(t->entries[mask] != NULL);
+      }
+    }
+    t->entry_count[mask] = n;
+    qsort(t->entries[mask], n, sizeof(macro_entry), compare_macro_entries);
+  }
+  return 0;
+}
+
+// Busca linha a linha no tabuleiro de macro-peças
+int macro_search(game *g, macro_table *t, unsigned int cell) {
+  unsigned int half = t->half;
+  if (cell == half * half) return 1;
+  unsigned int x = cell % half, y = cell / half;
+  unsigned int north[2] = {0, 0}, west[2] = {0, 0};
+  if (y > 0) macro_side(g, &t->blocks[t->choice[cell - half]], 2, north);
+  if (x > 0) macro_side(g, &t->blocks[t->choice[cell - 1]], 1, west);
+  unsigned long long key = macro_key(north, west);
+
+  unsigned int mask = macro_mask(half, x, y);
+  const macro_entry *e = t->entries[mask];
+  unsigned int lo = 0, hi = t->entry_count[mask];
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (e[mid].key < key) lo = mid + 1;
+    else hi = mid;
+  }
+
+  for (unsigned int k = lo; k < t->entry_count[mask] && e[k].key == key; k++) {
+    const macro_block *b = &t->blocks[e[k].block];
+    int free_tiles = 1;
+    for (int p = 0; p < 4 && free_tiles; p++)
+      free_tiles = !(t->used[b->tile[p] / 64] >> (b->tile[p] % 64) & 1);
+    if (!free_tiles) continue;
+    for (int p = 0; p < 4; p++) t->used[b->tile[p] / 64] |= 1ULL << (b->tile[p] % 64);
+    t->choice[cell] = e[k].block;
+    if (macro_search(g, t, cell + 1)) return 1;
+    for (int p = 0; p < 4; p++) t->used[b->tile[p] / 64] &= ~(1ULL << (b->tile[p] % 64));
+  }
+  return 0;
+}
+
+// Copia a solução do tabuleiro de macro-peças para o tabuleiro do jogo
+void macro_apply(game *g, const macro_table *t) {
+  for (unsigned int cell = 0; cell < t->half * t->half; cell++) {
+    const macro_block *b = &t->blocks[t->choice[cell]];
+    for (int p = 0; p < 4; p++) {
+      tile *tl = &g->tiles[b->tile[p]];
+      tl->rotation = (b->rot >> (2 * p)) & 3;
+      tl->used = 1;
+      g->board[2 * (cell / t->half) + p / 2][2 * (cell % t->half) + p % 2] = tl;
+    }
+  }
+}
+
+void free_macro(macro_table *t) {
+  free(t->blocks);
+  for (int mask = 0; mask < 16; mask++) free(t->entries[mask]);
+  free(t->used);
+  free(t->choice);
+}
+
+// Retorna 1 se achou solução, 0 se não existe e -1 se a tabela passou de limit_mb megabytes
+int solve_macro(game *g, unsigned int limit_mb) {
+  if (g->size < 2 || g->tiles_vertice->count == 0) return 0;
+
+  macro_table t;
+  memset(&t, 0, sizeof(t));
+  t.half = g->size / 2;
+  t.limit = (size_t)limit_mb << 20;
+  int result = 0;
+  for (unsigned int a = 0; a < g->tile_count && result == 0; a++) result = macro_enumerate(g, &t, a);
+  if (result == 0) result = macro_index(g, &t);
+
+  if (result == 0) {
+    fprintf(stderr, "Macro-peças: %u blocos 2x2 (%.1f MB)\n", t.count, (double)t.count * sizeof(macro_block) / (1 << 20));
+    t.words = (g->tile_count + 63) / 64;
+    t.used = calloc(t.words, sizeof(unsigned long long));
+    t.choice = malloc(t.half * t.half * sizeof(unsigned int));
+    assert(t.used != NULL && t.choice != NULL);
+    result = macro_search(g, &t, 0);
+    if (result) macro_apply(g, &t);
+  }
+
+  free_macro(&t);
+  return result;
+}
+
 int main (int argc, char **argv) {
   clock_t start_time, end_time;
   double cpu_time_used;
   start_time = clock();
+  select_filter();
 
-  game *g = initialize(stdin);
+  int ordering = ORDER_ID;
+  unsigned int nogood_mb = 0;
+  int solver = SOLVER_SPIRAL;
+  unsigned int mitm_mb = 1024; // limite (-b) das tabelas de mitm e de macro
+  unsigned int probes = 0;
+  int count_all = 0;
+  unsigned int endgame_cells = ENDGAME_DEFAULT;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      ordering = parse_ordering(argv[++i]);
+      if (ordering < 0) {
+        fprintf(stderr, "Heurística de ordenação inválida: %s (use id, rare, constraint ou fails)\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-m") == 0 && i + 1 < argc) {
+      nogood_mb = (unsigned int)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+      i++;
+      if (strcmp(argv[i], "spiral") == 0) solver = SOLVER_SPIRAL;
+      else if (strcmp(argv[i], "mitm") == 0) solver = SOLVER_MITM;
+      else if (strcmp(argv[i], "dlx") == 0) solver = SOLVER_DLX;
+      else if (strcmp(argv[i], "auto") == 0) solver = SOLVER_AUTO;
+      else if (strcmp(argv[i], "macro") == 0) solver = SOLVER_MACRO;
+      else {
+        fprintf(stderr, "Algoritmo inválido: %s (use spiral, mitm, dlx, auto ou macro)\n", argv[i]);
+        return 1;
+      }
+    } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+      mitm_mb = (unsigned int)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      probes = (unsigned int)strtoul(argv[++i], NULL, 10);
+    } else if (strcmp(argv[i], "-c") == 0) {
+      count_all = 1;
+    } else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) {
+      endgame_cells = (unsigned int)strtoul(argv[++i], NULL, 10);
+      if (endgame_cells > ENDGAME_MAX) {
+        fprintf(stderr, "Fim de jogo de no máximo %d células (-f)\n", ENDGAME_MAX);
+        return 1;
+      }
+    } else {
+      fprintf(stderr, "Uso: %s [-o id|rare|constraint|fails] [-m MB_nogoods] [-s spiral|mitm|dlx|auto|macro] [-b MB_tabela] [-e amostras] [-c] [-f celulas_fim] < entrada\n", argv[0]);
+      return 1;
+    }
+  }
+  if (count_all && solver != SOLVER_DLX) {
+    fprintf(stderr, "A contagem de soluções (-c) só existe com -s dlx\n");
+    return 1;
+  }
+
+  game *g = initialize(stdin, ordering, nogood_mb);
+  g->endgame = endgame_cells;
 
   int initial_vertex_choice = 0; 
-  if (play_first(g, initial_vertex_choice)) {
+  // Sem dicas, girar o tabuleiro leva qualquer canto para (0,0) e basta uma peça de vértice;
+  // as dicas quebram essa simetria e cada peça de vértice precisa ser tentada no canto
+  int last_vertex_choice = g->clues ? 3 : initial_vertex_choice;
+  int found = -1;
+  // Estimativa antes da busca; o custo por nó das próprias amostras dá a previsão de tempo
+  if (probes > 0 && solver == SOLVER_SPIRAL) {
+    unsigned long long seed = 0x5EED, nodes = 0;
+    clock_t estimate_start = clock();
+    double estimate = 0;
+    for (int v = initial_vertex_choice; v <= last_vertex_choice; v++)
+      estimate += estimate_task(g, v, probes, &seed, &nodes);
+    double per_node = (double)(clock() - estimate_start) / CLOCKS_PER_SEC / (nodes ? nodes : 1);
+    fprintf(stderr, "Estimativa da árvore completa: %.3e nós, ETA %.3f segundos (%u amostras)\n", estimate, estimate * per_node, probes);
+  }
+  if (solver == SOLVER_MITM && g->clues) {
+    fprintf(stderr, "Meet-in-the-middle não aceita dicas, usando a busca em espiral\n");
+  } else if (solver == SOLVER_MITM) {
+    found = solve_mitm(g, mitm_mb);
+    if (found == -1)
+      fprintf(stderr, "Meet-in-the-middle passou de %u MB, voltando para a busca em espiral\n", mitm_mb);
+    else if (found == -2)
+      fprintf(stderr, "Meet-in-the-middle passou de %llu nós, voltando para a busca em espiral\n", MITM_NODE_BUDGET);
+  } else if (solver == SOLVER_MACRO && (g->size % 2 || g->clues)) {
+    fprintf(stderr, "Macro-peças 2x2 precisam de lado par e sem dicas, usando a busca em espiral\n");
+  } else if (solver == SOLVER_MACRO) {
+    found = solve_macro(g, mitm_mb);
+    if (found < 0)
+      fprintf(stderr, "Tabela de macro-peças passou de %u MB, voltando para a busca em espiral\n", mitm_mb);
+  } else if (solver == SOLVER_DLX) {
+    dlx *d = build_dlx(g, count_all);
+    found = dlx_search(d, g, 0);
+    if (count_all) printf("Total de soluções: %llu\n", d->solutions);
+    free_dlx(d);
+  } else if (solver == SOLVER_AUTO) {
+    // Aqui as sondas rodam uma depois da outra; a versão MPI as divide entre os processos.
+    // A solução de uma sonda já é a resposta, e as que esgotam a árvore descartam o seu canto.
+    auto_probe candidates[AUTO_MAX_PROBES];
+    int n = auto_candidates(g, profile_colors(g, 1), candidates), ran = 0;
+    found = 0;
+    while (ran < n && !found) {
+      found = run_probe(g, &candidates[ran], AUTO_PROBE_SECONDS);
+      report_probe(&candidates[ran++]);
+    }
+    unsigned int exhausted = auto_exhausted(candidates, ran);
+    if (!found && ran > 0 && auto_unsolvable(g, exhausted)) {
+      fprintf(stderr, "As sondas esgotaram a árvore: não há solução\n");
+    } else if (!found && ran > 0) {
+      int best = auto_winner(candidates, ran);
+      g->ordering = candidates[best].ordering;
+      order_candidates(g);
+      initial_vertex_choice = candidates[best].vertex_choice;
+      // Com dicas cada canto é uma busca à parte; os outros vêm depois, no mesmo sentido
+      found = play_first(g, initial_vertex_choice);
+      for (int v = 0; v < 4 && !found && g->clues; v++)
+        if (v != initial_vertex_choice % 4 && !(exhausted >> v & 1))
+          found = play_first(g, initial_vertex_choice - initial_vertex_choice % 4 + v);
+    } else if (found) {
+      auto_winner(candidates, ran);
+    }
+  }
+  if (found < 0) {
+    found = 0;
+    for (int v = initial_vertex_choice; v <= last_vertex_choice && !found; v++) found = play_first(g, v);
+  }
+  if (count_all) {
+    // O total já foi impresso
+  } else if (found) {
     print_solution(g);
   } else {
     printf("SOLUTION NOT FOUND (iniciando com a peça de vértice de índice %d)\n", initial_vertex_choice);